@@ -4,8 +4,15 @@
 #include <ActiveTickServerAPI.h>
 #include "helpers.h"
 #include "exception.h"
+#include "backing.h"
 #include "queue.h"
+#include "symbols.h"
+#include "calendar.h"
 #include "message.h"
+#include "columns.h"
+#include "broadcast.h"
+#include "binary.h"
+#include "requests.h"
 
 using namespace node;
 using namespace v8;
@@ -16,47 +23,174 @@ static char buffer[1024];
 static uv_async_t callbackHandle;
 static Persistent<Function> callback;
 static std::atomic<int> pushes(0);
-static Queue q(16 * 1024 * 1024);
-static Queue priority(1 * 1024 * 1024);
+// Messages are queued by class: control messages (session, login, success and error),
+// the live stream, and bulk history responses.
+// SDK callback threads each get their own lane, so bursts on one don't contend with another.
+// Lanes start small and grow in segments, so memory follows the load.
+static Queue control(1 * 1024 * 1024);
+static Queue live(1 * 1024 * 1024, 3, 64 * 1024 * 1024);
+static Queue bulk(1 * 1024 * 1024, 3, 64 * 1024 * 1024);
 static uint64_t theSession = 0ul;
+// the live stream, for other processes
+static Broadcast* broadcast = NULL;
+
+// Each batch takes up to its quota from each class in turn, so a big backfill can't hold up the stream,
+// and whatever room is left over goes to the classes in the same order
+struct Class {
+	const char* name;
+	Queue& queue;
+	size_t quota;
+};
+
+static Class classes[] = {
+	{ "control", control, 128 },
+	{ "live", live, 640 },
+	{ "bulk", bulk, 256 },
+};
+static const int ClassCount = sizeof(classes) / sizeof(classes[0]);
+
+// Stream updates may be delivered lazily, as objects that read their messages only while the callback runs
+static bool lazy = false;
+static Handle<Object> lazies[1024 + 1];
+static int lazyCount = 0;
+
+// Or stream trades and quotes may be delivered as columns, a batch of each per callback, with symbols by number
+static bool columnar = false;
+static Columns<StreamUpdateTradeMessage> tradeColumns;
+static Columns<StreamUpdateQuoteMessage> quoteColumns;
+
+// Or they may be delivered as a single Buffer of fixed-layout records per callback
+static bool binary = false;
+static Records records;
+
+// the requests in flight, by handle
+static Requests requests;
+// the first exception a request's handler threw during a batch, reported once the batch is popped
+static Persistent<Value> thrown;
 
 int triggerCallback() {
 	pushes = 0;
 	return uv_async_send(&callbackHandle);
 }
 
-int popQueues(Handle<Value>* argv, int len) {
-	Message* message;
-	int argc = 0;
-
-	while (argc < len && (message = priority.pop<Message>())) {
-		argv[argc++] = message->value();
-		message->~Message();
-		Message::operator delete(message, priority);
+// A request's messages go straight to its handler, if it has one, and are done with here.
+// Those of a request without one join the batch for the callback, known by the request's handle.
+// Either way, the last message lets the handle go.
+bool dispatched(Message* message) {
+	auto request = message->request;
+	auto handle = requests.find(request);
+	// forgotten
+	if (!handle)
+		return true;
+	message->request = handle;
+
+	auto handler = Local<Function>::New(requests.handler(handle));
+	if (handler.IsEmpty()) {
+		if (message->end)
+			requests.remove(handle);
+		return false;
 	}
-
-	while (argc < len && (message = q.pop<Message>())) {
+	Handle<Value> value = message->value();
+	TryCatch tryCatch;
+	handler->Call(Null().As<Object>(), 1, &value);
+	if (tryCatch.HasCaught() && thrown.IsEmpty())
+		thrown = Persistent<Value>::New(tryCatch.Exception());
+	// the handler may have forgotten the request already, and its handle gone to a new one
+	if (message->end)
+		requests.end(handle, request);
+	return true;
+}
+
+// an exception from a handler surfaces as one from the callback would, as uncaught
+void reportThrown() {
+	if (thrown.IsEmpty())
+		return;
+	TryCatch tryCatch;
+	ThrowException(thrown);
+	thrown.Dispose();
+	thrown.Clear();
+	FatalException(tryCatch);
+}
+
+// returns how many messages were popped, which may be more than the values added to argv
+int popQueue(Queue::Run& run, size_t count, Handle<Value>* argv, int& argc) {
+	Message* message;
+	int popped = 0;
+
+	run.allow(count);
+	while ((message = run.pop<Message>())) {
+		++popped;
+		if (message->request && dispatched(message))
+			continue;
+		if (binary && Records::encodes(message->type)) {
+			records.add(message);
+			continue;
+		}
+		if (columnar && message->type == Message::StreamUpdateTrade) {
+			tradeColumns.add((StreamUpdateTradeMessage*)message);
+			continue;
+		}
+		if (columnar && message->type == Message::StreamUpdateQuote) {
+			quoteColumns.add((StreamUpdateQuoteMessage*)message);
+			continue;
+		}
+		if (lazy && Message::lazilyDelivered(message->type)) {
+			argv[argc++] = lazies[lazyCount++] = message->lazy();
+			continue;
+		}
 		argv[argc++] = message->value();
-		message->~Message();
-		Message::operator delete(message, q);
 	}
 
-	return argc;
+	return popped;
 }
 
 void executeCallback(uv_async_t* handle, int status) {
 	assert(handle == &callbackHandle);
 	const int argvLength = 1024 + 1;
-	static Handle<Value> argv[argvLength];
+	// and room for a batch of trade and of quote columns, or of records
+	static Handle<Value> argv[argvLength + 2];
 
 	HandleScope scope;
-	int argc = popQueues(argv, argvLength);
+
+	// strings, and the symbols table, for whatever the producers have numbered since last time
+	symbolTable.catchUp();
+
+	// the messages are released all at once, when the runs go out of scope
+	Queue::Run runs[ClassCount];
+	int popped = 0;
+	int argc = 0;
+	for (int i = 0; i < ClassCount; ++i) {
+		auto quota = classes[i].quota < (size_t)(argvLength - popped) ? classes[i].quota : argvLength - popped;
+		runs[i].from(classes[i].queue);
+		popped += popQueue(runs[i], quota, argv, argc);
+	}
+	for (int i = 0; i < ClassCount && popped < argvLength; ++i)
+		popped += popQueue(runs[i], argvLength - popped, argv, argc);
+	reportThrown();
+
+	if (tradeColumns.count())
+		argv[argc++] = tradeColumns.value();
+	if (quoteColumns.count())
+		argv[argc++] = quoteColumns.value();
+	if (records.count())
+		argv[argc++] = records.value();
 
 	if (argc)
 	{
 		callback->Call(Null().As<Object>(), argc, argv);
-		triggerCallback();
+
+		// the lazy objects outlive their messages, so they must let go before the runs release them
+		for (int i = 0; i < lazyCount; ++i)
+			Message::release(lazies[i]);
+		lazyCount = 0;
+		tradeColumns.clear();
+		quoteColumns.clear();
+		records.clear();
 	}
+
+	// even if handlers took the whole batch, there may well be more behind it
+	if (popped)
+		triggerCallback();
 }
 
 const char* registerAsync(uv_async_t* handle, uv_async_cb exec) {
@@ -76,41 +210,51 @@ const char* initializeAsync() {
 }
 
 inline void pushSuccess(uint64_t request, Message::Type messageType, uint32_t records) {
-	priority.push(new(priority)SuccessMessage(theSession, request, messageType, records));
+	control.push(new(control)SuccessMessage(theSession, request, messageType, records));
 	triggerCallback();
 }
 
 inline void pushError(uint64_t request, const std::exception& ex) {
-	priority.push(new(priority)ErrorMessage(theSession, request, ex.what()));
+	control.push(new(control)ErrorMessage(theSession, request, ex.what()));
 	triggerCallback();
 }
 
-inline void pushMessage(Message* m, bool trigger = false) {
-	q.push(m);
+inline void pushMessage(Queue& queue, Message* m, bool trigger = false) {
+	queue.push(m, m->key());
 	if (++pushes == 1024 || trigger)
 		triggerCallback();
 }
 
 void onStreamUpdate(LPATSTREAM_UPDATE update) {
 	try {
+		// numbered first: the allocation may happen before a constructor's arguments are evaluated,
+		// and room claimed in the queue must be filled
 		Message* message;
+		uint32_t id;
 		switch (update->updateType) {
 			case StreamUpdateTrade:
-				message = new(q)StreamUpdateTradeMessage(update->trade);
+				if (broadcast)
+					broadcast->publish(update->trade);
+				id = Message::number(update->trade.symbol);
+				message = new(live)StreamUpdateTradeMessage(update->trade, id);
 				break;
 			case StreamUpdateQuote:
-				message = new(q)StreamUpdateQuoteMessage(update->quote);
+				if (broadcast)
+					broadcast->publish(update->quote);
+				id = Message::number(update->quote.symbol);
+				message = new(live)StreamUpdateQuoteMessage(update->quote, id);
 				break;
 			case StreamUpdateRefresh:
-				message = new(q)StreamUpdateRefreshMessage(update->refresh);
+				id = Message::number(update->refresh.symbol);
+				message = new(live)StreamUpdateRefreshMessage(update->refresh, id);
 				break;
 			case StreamUpdateTopMarketMovers:
-				//message = new(q)StreamUpdateTopMarketMoversMessage(update->marketMovers);
+				//message = new(live)StreamUpdateTopMarketMoversMessage(update->marketMovers);
 				//break;
 			default:
 				throw bad_data();
 		}
-		pushMessage(message, true);
+		pushMessage(live, message, true);
 	}
 	catch (std::exception& e) {
 		pushError(0, e);
@@ -119,7 +263,7 @@ void onStreamUpdate(LPATSTREAM_UPDATE update) {
 
 void onServerTimeUpdate(LPATTIME time) {
 	try {
-		pushMessage(new(q)ServerTimeUpdateMessage(*time), true);
+		pushMessage(live, new(live)ServerTimeUpdateMessage(*time), true);
 	}
 	catch (std::exception& e) {
 		pushError(0, e);
@@ -128,7 +272,7 @@ void onServerTimeUpdate(LPATTIME time) {
 
 void onSessionStatusChange(uint64_t session, ATSessionStatusType statusType) {
 	try {
-		pushMessage(new(q)SessionStatusChangeMessage(session, statusType), true);
+		pushMessage(control, new(control)SessionStatusChangeMessage(session, statusType), true);
 	}
 	catch (std::exception& e) {
 		pushError(0, e);
@@ -149,7 +293,7 @@ void onRequestTimeout(uint64_t request) {
 void onLoginResponse(uint64_t session, uint64_t request, LPATLOGIN_RESPONSE pResponse) {
 	try {
 		assert(session == theSession);
-		pushMessage(new(q)LoginResponseMessage(theSession, request, *pResponse), true);
+		pushMessage(control, new(control)LoginResponseMessage(theSession, request, *pResponse), true);
 	}
 	catch (std::exception& e) {
 		pushError(request, e);
@@ -162,11 +306,11 @@ void onQuoteStreamResponse(uint64_t request, ATStreamResponseType responseType,
 	try {
 		assert(responseType == response->responseType);
 		if (response->dataItemCount == 0)
-			pushMessage(new(q)M(theSession, request, responseType));
+			pushMessage(live, new(live)M(theSession, request, responseType));
 		LPATQUOTESTREAM_DATA_ITEM items = (LPATQUOTESTREAM_DATA_ITEM)(response + 1);
 		auto last = response->dataItemCount - 1;
 		for (uint16_t i = 0; i <= last; ++i)
-			pushMessage(new(q)M(theSession, request, responseType, items[i], i == last));
+			pushMessage(live, new(live)M(theSession, request, responseType, items[i], i == last));
 		triggerCallback();
 	}
 	catch (std::exception& e) {
@@ -179,7 +323,7 @@ void onHolidaysResponse(uint64_t request, LPATMARKET_HOLIDAYSLIST_ITEM items, ui
 	try {
 		auto last = count - 1;
 		for (uint32_t i = 0; i <= last; ++i)
-			pushMessage(new(q)HolidayMessage(theSession, request, items[i], i == last));
+			pushMessage(bulk, new(bulk)HolidayMessage(theSession, request, items[i], i == last));
 		pushSuccess(request, Message::Type::HolidaysResponse, count);
 	}
 	catch (std::exception& e) {
@@ -188,6 +332,11 @@ void onHolidaysResponse(uint64_t request, LPATMARKET_HOLIDAYSLIST_ITEM items, ui
 	bool bstat = ATCloseRequest(theSession, request);
 }
 
+template <typename A, typename B>
+inline size_t largest() {
+	return sizeof(A) > sizeof(B) ? sizeof(A) : sizeof(B);
+}
+
 void onTickHistoryResponse(uint64_t request, ATTickHistoryResponseType responseType, LPATTICKHISTORY_RESPONSE response) {
 	try {
 		if (responseType != ATTickHistoryResponseType::TickHistoryResponseSuccess)
@@ -196,22 +345,22 @@ void onTickHistoryResponse(uint64_t request, ATTickHistoryResponseType responseT
 			throw failure(response->status);
 		LPATTICKHISTORY_RECORD record = (LPATTICKHISTORY_RECORD)(response + 1);
 		auto last = response->recordCount - 1;
+		Queue::Batch batch(bulk, response->recordCount, largest<TickHistoryTradeMessage, TickHistoryQuoteMessage>());
 		for (uint32_t i = 0; i <= last; ++i) {
-			Message* message;
 			switch (record->recordType) {
 				case TickHistoryRecordTrade:
-					message = new(q)TickHistoryTradeMessage(theSession, request, record->trade, i == last);
+					new(batch)TickHistoryTradeMessage(theSession, request, record->trade, i == last);
 					record = (LPATTICKHISTORY_RECORD)(&record->trade + 1);
 					break;
 				case TickHistoryRecordQuote:
-					message = new(q)TickHistoryQuoteMessage(theSession, request, record->quote, i == last);
+					new(batch)TickHistoryQuoteMessage(theSession, request, record->quote, i == last);
 					record = (LPATTICKHISTORY_RECORD)(&record->quote + 1);
 					break;
 				default:
 					throw bad_data();
 			}
-			pushMessage(message);
 		}
+		batch.commit();
 		pushSuccess(request, Message::Type::TickHistoryResponse, response->recordCount);
 	}
 	catch (std::exception& e) {
@@ -222,11 +371,13 @@ void onTickHistoryResponse(uint64_t request, ATTickHistoryResponseType responseT
 
 void onBarHistoryResponse(uint64_t request, ATBarHistoryResponseType responseType, LPATBARHISTORY_RESPONSE response) {
 	try {
-		pushMessage(new(q)BarHistoryResponseMessage(theSession, request, responseType, *response));
+		Queue::Batch batch(bulk, response->recordCount + 2, largest<BarHistoryResponseMessage, BarHistoryMessage>());
+		new(batch)BarHistoryResponseMessage(theSession, request, responseType, *response);
 		LPATBARHISTORY_RECORD records = (LPATBARHISTORY_RECORD)(response + 1);
 		for (uint32_t i = 0; i < response->recordCount; ++i)
-			pushMessage(new(q)BarHistoryMessage(theSession, request, records[i]));
-		pushMessage(new(q)ResponseCompleteMessage(theSession, request));
+			new(batch)BarHistoryMessage(theSession, request, records[i]);
+		new(batch)ResponseCompleteMessage(theSession, request);
+		batch.commit();
 		triggerCallback();
 	}
 	catch (std::exception& e) {
@@ -235,11 +386,46 @@ void onBarHistoryResponse(uint64_t request, ATBarHistoryResponseType responseTyp
 	bool bstat = ATCloseRequest(theSession, request);
 }
 
-Handle<Value> send(uint64_t request) {
+// The request is known by its handle before it's sent, since nothing it brings back is delivered until this returns.
+// 'handler', if a function, gets the request's messages, one at a time, instead of the callback.
+Handle<Value> send(uint64_t request, Handle<Value> handler) {
+	auto handle = requests.add(request, handler);
+	if (!handle) {
+		ATCloseRequest(theSession, request);
+		return v8throw("too many requests in flight");
+	}
 	bool bstat = ATSendRequest(theSession, request, DEFAULT_REQUEST_TIMEOUT, onRequestTimeout);
-	if (!bstat)
+	if (!bstat) {
+		requests.remove(handle);
 		return v8error("error in ATSendRequest");
-	return v8string(theSession, request);
+	}
+	return v8number(handle);
+}
+
+// forget(handle) drops whatever else comes for a request, and lets its handle go
+Handle<Value> forget(const Arguments& args) {
+	requests.remove(args[0]->Uint32Value());
+	return Undefined();
+}
+
+bool overflowPolicy(Handle<Value> value, Queue& queue) {
+	if (value->IsUndefined())
+		return true;
+
+	String::AsciiValue policy(value);
+	if (!strcmp(*policy, "throw"))
+		queue.overflow(Queue::Throw);
+	else if (!strcmp(*policy, "block"))
+		queue.overflow(Queue::Block);
+	else if (!strcmp(*policy, "drop-newest"))
+		queue.overflow(Queue::DropNewest);
+	else if (!strcmp(*policy, "drop-oldest"))
+		queue.overflow(Queue::DropOldest);
+	else if (!strcmp(*policy, "conflate"))
+		queue.overflow(Queue::Conflate);
+	else
+		return false;
+	return true;
 }
 
 union ApiKey {
@@ -259,6 +445,85 @@ Handle<Value> connect(const Arguments& args) {
 
 	auto callbackArg = args[1].As<Function>();
 
+	if (args[2]->IsObject()) {
+		auto options = args[2].As<Object>();
+		auto overflow = options->Get(v8symbol("overflow"));
+		if (!overflowPolicy(overflow, live) || !overflowPolicy(overflow, bulk))
+			return v8throw("invalid overflow policy");
+		if (!overflowPolicy(options->Get(v8symbol("priorityOverflow")), control))
+			return v8throw("invalid priorityOverflow policy");
+		auto queueLimit = options->Get(v8symbol("queueLimit"));
+		if (queueLimit->IsNumber()) {
+			live.limit((size_t)queueLimit->NumberValue());
+			bulk.limit((size_t)queueLimit->NumberValue());
+		}
+
+		// quotas: how many messages of each class to deliver per batch, before the others get a turn
+		auto quotas = options->Get(v8symbol("quotas"));
+		if (quotas->IsObject()) {
+			for (int i = 0; i < ClassCount; ++i) {
+				auto quota = quotas.As<Object>()->Get(v8symbol(classes[i].name));
+				if (quota->IsNumber())
+					classes[i].quota = (size_t)quota->NumberValue();
+			}
+		}
+
+		// spill: true for the temp directory, or a directory of your choosing
+		auto spill = options->Get(v8symbol("spill"));
+		auto spillLimit = options->Get(v8symbol("spillLimit"));
+		size_t limit = spillLimit->IsNumber() ? (size_t)spillLimit->NumberValue() : 256 * 1024 * 1024;
+		if (spill->IsString()) {
+			live.spill(*String::AsciiValue(spill), limit);
+			bulk.spill(*String::AsciiValue(spill), limit);
+		}
+		else if (spill->BooleanValue()) {
+			live.spill(SpillFile::temporaryDirectory(), limit);
+			bulk.spill(SpillFile::temporaryDirectory(), limit);
+		}
+
+		// lazy: stream updates arrive as thin objects whose fields are read when touched, and only during the callback;
+		// call detach() on one to keep a plain copy
+		lazy = options->Get(v8symbol("lazy"))->BooleanValue();
+
+		// columnar: stream trades and quotes arrive as one object of typed array columns each, per callback;
+		// symbols are numbers, exchanges are codes, and conditions and flags are bitmasks, all named by the module's tables
+		columnar = options->Get(v8symbol("columnar"))->BooleanValue();
+
+		// binary: stream trades and quotes arrive as one Buffer of records per callback, laid out as binary.h describes
+		binary = options->Get(v8symbol("binary"))->BooleanValue();
+
+		// booleanFlags: conditions and trade flags as an object of booleans in the flags field, rather than as bitmasks
+		Message::booleanFlags() = options->Get(v8symbol("booleanFlags"))->BooleanValue();
+
+		// fixedPoint: stream trade and quote prices as integers in units of 10^-precision, with their precision,
+		// in messages, columns and records alike; decimal() writes them out
+		Message::fixedPoint() = options->Get(v8symbol("fixedPoint"))->BooleanValue();
+
+		// broadcast: the name of a shared memory ring for other processes to attach to
+		auto broadcastName = options->Get(v8symbol("broadcast"));
+		if (broadcastName->IsString() && !broadcast) {
+			auto slots = options->Get(v8symbol("broadcastSlots"));
+			broadcast = new Broadcast(*String::AsciiValue(broadcastName), slots->IsNumber() ? slots->Uint32Value() : 64 * 1024);
+			if (!broadcast->open()) {
+				delete broadcast;
+				broadcast = NULL;
+				return v8throw("cannot create broadcast");
+			}
+		}
+
+		Backing backing;
+		backing.largePages = options->Get(v8symbol("largePages"))->BooleanValue() && Backing::enableLargePages();
+		backing.prefault = options->Get(v8symbol("prefault"))->BooleanValue();
+		backing.lock = options->Get(v8symbol("lockMemory"))->BooleanValue();
+		auto numaNode = options->Get(v8symbol("numaNode"));
+		if (numaNode->IsNumber())
+			backing.node = numaNode->Int32Value();
+		if (backing.largePages || backing.prefault || backing.lock || backing.node >= 0) {
+			for (int i = 0; i < ClassCount; ++i)
+				classes[i].queue.backing(backing);
+		}
+	}
+
 	theSession = ATCreateSession();
 	bool bstat;
 	bstat = ATSetAPIUserId(theSession, &apikey.atGuid);
@@ -282,13 +547,117 @@ Handle<Value> connect(const Arguments& args) {
 }
 
 Handle<Value> disconnect(const Arguments& args) {
+	// the SDK waits for its callbacks, which must not wait for a callback of ours meanwhile
+	for (int i = 0; i < ClassCount; ++i)
+		classes[i].queue.interrupt();
 	ATShutdownSession(theSession);
 	ATDestroySession(theSession);
 	theSession = 0;
+	for (int i = 0; i < ClassCount; ++i)
+		classes[i].queue.interrupt(false);
 	uv_unref((uv_handle_t*)&callbackHandle);
 	return True();
 }
 
+Handle<Value> stats(Queue& queue) {
+	auto stats = queue.stats();
+	auto value = Object::New();
+	v8set(value, "allocated", (double)stats.allocated);
+	v8set(value, "occupied", (double)stats.occupied);
+	v8set(value, "highWater", (double)stats.highWater);
+	v8set(value, "claims", (double)stats.claims);
+	v8set(value, "collisions", (double)stats.collisions);
+	v8set(value, "sleeps", (double)stats.sleeps);
+	v8set(value, "wraps", (double)stats.wraps);
+	v8set(value, "popped", (double)stats.popped);
+	v8set(value, "dropped", (double)stats.dropped);
+	v8set(value, "spilled", (double)stats.spilled);
+	v8set(value, "drained", (double)stats.drained);
+	return value;
+}
+
+// counters for each class's queue, read without getting in the producers' way
+Handle<Value> stats(const Arguments& args) {
+	auto value = Object::New();
+	for (int i = 0; i < ClassCount; ++i)
+		v8set(value, classes[i].name, stats(classes[i].queue));
+	return value;
+}
+
+static Persistent<ObjectTemplate> readerTemplate;
+
+void onReaderCollected(Persistent<Value> object, void* reader) {
+	delete (Broadcast::Reader*)reader;
+	object.Dispose();
+}
+
+// a broadcast record looks just like the message the producer's own callback got,
+// or like the error it would have got, if this process's symbols table is full
+Handle<Value> value(const Broadcast::Record& record) {
+	try {
+		switch (record.type) {
+			case Message::StreamUpdateTrade: {
+				ATQUOTESTREAM_TRADE_UPDATE trade;
+				record.to(trade);
+				return StreamUpdateTradeMessage(trade, Message::number(trade.symbol)).value();
+			}
+			case Message::StreamUpdateQuote: {
+				ATQUOTESTREAM_QUOTE_UPDATE quote;
+				record.to(quote);
+				return StreamUpdateQuoteMessage(quote, Message::number(quote.symbol)).value();
+			}
+		}
+	}
+	catch (std::exception& e) {
+		return ErrorMessage(0, 0, e.what()).value();
+	}
+	return Undefined();
+}
+
+// reader.read(max) returns what has been broadcast since the last read, up to 'max' messages
+Handle<Value> read(const Arguments& args) {
+	auto reader = (Broadcast::Reader*)args.This()->GetPointerFromInternalField(0);
+	uint32_t max = args[0]->IsNumber() ? args[0]->Uint32Value() : 1024;
+	auto messages = Array::New();
+	Broadcast::Record record;
+	uint32_t lost;
+	for (uint32_t n = 0; n < max; ) {
+		auto status = reader->read(record, lost);
+		if (status == Broadcast::Reader::Empty)
+			break;
+		if (status == Broadcast::Reader::Lapped) {
+			auto value = Object::New();
+			v8set(value, names::message, Handle<String>(names::lapped));
+			v8set(value, names::lost, lost);
+			messages->Set(n++, value);
+			continue;
+		}
+		messages->Set(n++, value(record));
+	}
+	return messages;
+}
+
+// attach to another process's broadcast, by name
+Handle<Value> attach(const Arguments& args) {
+	String::AsciiValue name(args[0]);
+	auto reader = new Broadcast::Reader(*name);
+	if (!reader->open()) {
+		delete reader;
+		return v8throw("cannot attach to broadcast");
+	}
+
+	if (readerTemplate.IsEmpty()) {
+		readerTemplate = Persistent<ObjectTemplate>::New(ObjectTemplate::New());
+		readerTemplate->SetInternalFieldCount(1);
+		readerTemplate->Set(v8symbol("read"), FunctionTemplate::New(read));
+	}
+
+	auto object = readerTemplate->NewInstance();
+	object->SetPointerInInternalField(0, reader);
+	Persistent<Object>::New(object).MakeWeak(reader, onReaderCollected);
+	return object;
+}
+
 Handle<Value> logIn(const Arguments& args) {
 	String::Value const useridArg(args[0]);
 	auto userid = (const wchar16_t*)*useridArg;
@@ -296,7 +665,7 @@ Handle<Value> logIn(const Arguments& args) {
 	String::Value const passwordArg(args[1]);
 	auto password = (const wchar16_t*)*passwordArg;
 
-	return send(ATCreateLoginRequest(theSession, userid, password, onLoginResponse));
+	return send(ATCreateLoginRequest(theSession, userid, password, onLoginResponse), args[2]);
 }
 
 typedef struct _USSymbol : ATSYMBOL {
@@ -308,38 +677,50 @@ typedef struct _USSymbol : ATSYMBOL {
 	}
 } USSymbol;
 
+// symbolId(symbol) numbers a symbol, once and for good, as messages and the module's symbols table do
+Handle<Value> symbolId(const Arguments& args) {
+	String::Value const symbolArg(args[0]);
+	if (symbolArg.length() >= (int)Symbols::Length)
+		return v8throw("symbol too long");
+	auto id = symbolTable.add((const wchar16_t*)*symbolArg);
+	symbolTable.catchUp();
+	return v8number(id);
+}
+
+// decimal(price, precision) is a fixed-point price as an exact decimal string, for exports
+Handle<Value> decimal(const Arguments& args) {
+	auto precision = args[1]->Int32Value();
+	if (precision < 0 || precision > Message::MaxPrecision)
+		return v8throw("precision out of range");
+	char buffer[24];
+	auto length = formatDecimal(buffer, args[0]->IntegerValue(), precision);
+	return String::New(buffer, length);
+}
+
 Handle<Value> subscribe(const Arguments& args) {
 	String::Value const symbolArg(args[0]);
 	USSymbol s((const wchar16_t*)*symbolArg);
-	return send(ATCreateQuoteStreamRequest(theSession, &s, 1, StreamRequestSubscribe, onQuoteStreamResponse<StreamSubscribeResponseMessage>));
+	// so that its updates are stamped with its number as they arrive
+	symbolTable.add(s.symbol);
+	return send(ATCreateQuoteStreamRequest(theSession, &s, 1, StreamRequestSubscribe, onQuoteStreamResponse<StreamSubscribeResponseMessage>), args[1]);
 }
 
 Handle<Value> unsubscribe(const Arguments& args) {
 	String::Value const symbolArg(args[0]);
 	USSymbol s((const wchar16_t*)*symbolArg);
-	return send(ATCreateQuoteStreamRequest(theSession, &s, 1, StreamRequestUnsubscribe, onQuoteStreamResponse<StreamUnsubscribeResponseMessage>));
+	return send(ATCreateQuoteStreamRequest(theSession, &s, 1, StreamRequestUnsubscribe, onQuoteStreamResponse<StreamUnsubscribeResponseMessage>), args[1]);
 }
 
 Handle<Value> holidays(const Arguments& args) {
 	auto yearIndex = (int) args[0].As<Number>()->Value();
 	uint8_t yearsGoingBack = yearIndex < 0 ? -yearIndex : 0;
 	uint8_t yearsGoingForward = yearIndex < 0 ? 0 : yearIndex;
-	return send(ATCreateMarketHolidaysRequest(theSession, yearsGoingBack, yearsGoingForward, ExchangeComposite, CountryUnitedStates, onHolidaysResponse));
+	return send(ATCreateMarketHolidaysRequest(theSession, yearsGoingBack, yearsGoingForward, ExchangeComposite, CountryUnitedStates, onHolidaysResponse), args[1]);
 }
 
+// the exchange's wall-clock time, as the API wants it
 static inline ATTIME convert(long long time) {
-	time_t seconds = time / 1000;
-	tm* t = localtime(&seconds);
-	return {
-		t->tm_year + 1900,
-		t->tm_mon + 1,
-		t->tm_wday,
-		t->tm_mday,
-		t->tm_hour,
-		t->tm_min,
-		t->tm_sec,
-		(long long)time % 1000
-	};
+	return calendar.time(time);
 }
 
 Handle<Value> ticks(const Arguments& args, bool trades, bool quotes) {
@@ -352,7 +733,7 @@ Handle<Value> ticks(const Arguments& args, bool trades, bool quotes) {
 	ATTIME begin = convert(beginDate->Value());
 	ATTIME end = convert(endDate->Value() - 1);
 
-	return send(ATCreateTickHistoryDbRequest(theSession, s, trades, quotes, begin, end, onTickHistoryResponse));
+	return send(ATCreateTickHistoryDbRequest(theSession, s, trades, quotes, begin, end, onTickHistoryResponse), args[3]);
 
 	// ?? gets odd response type of 5
 	//return send(ATCreateTickHistoryDbRequest(theSession, s, trades, quotes, begin, 1000, CursorForward, onTickHistoryResponse));
@@ -388,7 +769,7 @@ Handle<Value> bars(const Arguments& args) {
 	ATTIME end = convert(endDate->Value());
 
 	auto type = BarHistoryDaily;
-	return send(ATCreateBarHistoryDbRequest(theSession, s, BarHistoryDaily, 0, begin, end, onBarHistoryResponse));
+	return send(ATCreateBarHistoryDbRequest(theSession, s, BarHistoryDaily, 0, begin, end, onBarHistoryResponse), args[3]);
 }
 
 const char* onInit() {
@@ -413,10 +794,21 @@ void main(Handle<Object> exports, Handle<Object> module) {
 
 	HandleScope scope;
 	if (!error) {
+		Message::intern();
+		initializeColumns();
+		Records::initialize();
+		Message::tables(exports);
+
 		v8set(exports, "version", ATGetAPIVersion());
 		v8set(exports, "connect", connect);
 		v8set(exports, "disconnect", disconnect);
+		v8set(exports, "stats", stats);
+		v8set(exports, "attach", attach);
 		v8set(exports, "logIn", logIn);
+		v8set(exports, "forget", forget);
+		v8set(exports, "symbolId", symbolId);
+		v8set(exports, "symbols", symbolTable.array());
+		v8set(exports, "decimal", decimal);
 		v8set(exports, "subscribe", subscribe);
 		v8set(exports, "unsubscribe", unsubscribe);
 		v8set(exports, "holidays", holidays);
@@ -0,0 +1,142 @@
+#include <string>
+#include <windows.h>
+
+namespace ActiveTickServerAPI_node {
+
+	// How a queue's memory is backed.  Whatever isn't available falls back to ordinary pages.
+	class Backing {
+		// VirtualAllocExNuma is Vista and later, so we look for it rather than link to it
+		typedef LPVOID (WINAPI *VirtualAllocExNumaFunction)(HANDLE, LPVOID, SIZE_T, DWORD, DWORD, DWORD);
+
+		void* commit(size_t size, DWORD flags) const {
+			flags |= MEM_RESERVE | MEM_COMMIT;
+			ULONG highest;
+			if (node >= 0 && GetNumaHighestNodeNumber(&highest) && (ULONG)node <= highest) {
+				auto virtualAllocExNuma = (VirtualAllocExNumaFunction)GetProcAddress(GetModuleHandleA("kernel32.dll"), "VirtualAllocExNuma");
+				if (virtualAllocExNuma) {
+					if (auto p = virtualAllocExNuma(GetCurrentProcess(), NULL, size, flags, PAGE_READWRITE, node))
+						return p;
+				}
+			}
+			return VirtualAlloc(NULL, size, flags, PAGE_READWRITE);
+		}
+
+		// locking more than the minimum working set fails, so make room for it
+		static bool lockPages(void* p, size_t size) {
+			if (VirtualLock(p, size))
+				return true;
+			auto process = GetCurrentProcess();
+			SIZE_T minimum, maximum;
+			if (!GetProcessWorkingSetSize(process, &minimum, &maximum))
+				return false;
+			if (!SetProcessWorkingSetSize(process, minimum + size, maximum + size))
+				return false;
+			return VirtualLock(p, size) != FALSE;
+		}
+
+		static void touchPages(void* p, size_t size) {
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			for (size_t i = 0; i < size; i += info.dwPageSize)
+				((volatile char*)p)[i] = 0;
+		}
+
+	public:
+		bool largePages;	// 2MB pages, which are always resident
+		bool prefault;		// touch every page up front, so producers don't fault on the first lap
+		bool lock;			// keep it resident
+		int node;			// preferred NUMA node, or -1 for any
+
+		Backing() : largePages(false), prefault(false), lock(false), node(-1) {}
+
+		bool operator==(const Backing& other) const {
+			return largePages == other.largePages && prefault == other.prefault && lock == other.lock && node == other.node;
+		}
+
+		// Large pages need the "Lock pages in memory" privilege, which must be enabled in our token
+		static bool enableLargePages() {
+			if (!GetLargePageMinimum())
+				return false;
+
+			HANDLE token;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+				return false;
+
+			TOKEN_PRIVILEGES privileges;
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			bool enabled = LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid)
+				&& AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL)
+				&& GetLastError() == ERROR_SUCCESS;
+			CloseHandle(token);
+			return enabled;
+		}
+
+		// committed memory reads as all zeroes; returns NULL only when there's no memory at all
+		void* allocate(size_t size) const {
+			if (largePages) {
+				auto page = GetLargePageMinimum();
+				if (auto p = commit((size + page - 1) & ~(page - 1), MEM_LARGE_PAGES))
+					return p;
+			}
+
+			auto p = commit(size, 0);
+			if (!p)
+				return NULL;
+			if (!(lock && lockPages(p, size)) && prefault)
+				touchPages(p, size);
+			return p;
+		}
+
+		static void release(void* p) {
+			VirtualFree(p, 0, MEM_RELEASE);
+		}
+	};
+
+	// A temporary file mapped into memory, which goes away when it's closed
+	class SpillFile {
+		SpillFile(const SpillFile&) = delete;
+		SpillFile& operator=(const SpillFile&) = delete;
+
+		HANDLE _file;
+		HANDLE _mapping;
+		void* _view;
+
+	public:
+		SpillFile(const std::string& directory, size_t size) : _file(INVALID_HANDLE_VALUE), _mapping(NULL), _view(NULL) {
+			char path[MAX_PATH];
+			if (!GetTempFileNameA(directory.c_str(), "atq", 0, path))
+				return;
+
+			_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+			if (_file == INVALID_HANDLE_VALUE)
+				return;
+
+			// a new mapping reads as all zeroes
+			_mapping = CreateFileMappingA(_file, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);
+			if (_mapping)
+				_view = MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		}
+
+		~SpillFile() {
+			if (_view)
+				UnmapViewOfFile(_view);
+			if (_mapping)
+				CloseHandle(_mapping);
+			if (_file != INVALID_HANDLE_VALUE)
+				CloseHandle(_file);
+		}
+
+		inline void* view() const {
+			return _view;
+		}
+
+		static std::string temporaryDirectory() {
+			char directory[MAX_PATH];
+			if (!GetTempPathA(MAX_PATH, directory))
+				return ".";
+			return directory;
+		}
+	};
+
+}
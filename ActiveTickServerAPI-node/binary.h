@@ -0,0 +1,170 @@
+#include <cstring>
+#include <node_buffer.h>
+
+namespace ActiveTickServerAPI_node {
+	using namespace v8;
+
+	// With { binary: true }, the stream's trades and quotes reach the callback as a single Buffer each time,
+	// encoded straight from the messages in the queue, for clients that only pass them along.  binary.js reads it.
+	//
+	// The layout, all little-endian:
+	//	 0	char	magic "ATBB"
+	//	 4	uint16	version
+	//	 6	uint16	record size, in bytes
+	//	 8	uint32	record count
+	//	12	uint32	flags: 1 when prices are fixed-point
+	//	16	records
+	//
+	// A record is the message as it was queued, normalized:
+	//	 0	uint8	Message::Type: 9 for StreamUpdateTrade, 10 for StreamUpdateQuote
+	//	 1	char	exchange: the trade's, or the bid's
+	//	 2	char	ask exchange
+	//	 3	uint8	price precision
+	//	 4	uint32	symbol, by its number in the module's symbols table
+	//	 8	double	time, in milliseconds since the epoch
+	//	16	double	price: the trade's, or the bid; or, when fixed-point, int64 in units of 10^-precision
+	//	24	double	ask price; or int64, when fixed-point
+	//	32	uint32	size: the trade's, or the bid's
+	//	36	uint32	ask size
+	//	40	uint32	trade flags
+	//	44	uint8	conditions [4]: the trade's, or the quote's alone
+	//
+	// A reader must skip records of a type it doesn't know, and must not assume the record size.
+	class Records {
+	public:
+		static const uint32_t Magic = 0x42425441;	// "ATBB"
+		static const uint16_t Version = 2;
+		static const size_t HeaderSize = 16;
+		static const uint32_t FixedPoint = 1;
+
+	private:
+		struct Header {
+			uint32_t magic;
+			uint16_t version;
+			uint16_t recordSize;
+			uint32_t count;
+			uint32_t flags;
+		};
+
+		struct Record {
+			uint8_t type;
+			uint8_t exchange;
+			uint8_t askExchange;
+			uint8_t precision;
+			uint32_t symbol;
+			double time;
+			union {
+				double price;
+				int64_t scaledPrice;
+			};
+			union {
+				double askPrice;
+				int64_t scaledAskPrice;
+			};
+			uint32_t size;
+			uint32_t askSize;
+			uint32_t flags;
+			uint8_t conditions[4];
+
+			void from(const StreamUpdateTradeMessage& trade) {
+				memset(this, 0, sizeof(*this));
+				type = trade.type;
+				exchange = trade.lastExchange;
+				symbol = trade.symbolId;
+				time = trade.time;
+				precision = trade.precision;
+				if (Message::fixedPoint())
+					scaledPrice = trade.lastPrice.scaled;
+				else
+					price = trade.lastPrice.raw;
+				size = trade.lastSize;
+				flags = trade.flags;
+				for (int i = 0; i < ATTradeConditionsCount && i < 4; ++i)
+					conditions[i] = trade.conditions[i];
+			}
+
+			void from(const StreamUpdateQuoteMessage& quote) {
+				memset(this, 0, sizeof(*this));
+				type = quote.type;
+				exchange = quote.bidExchange;
+				askExchange = quote.askExchange;
+				symbol = quote.symbolId;
+				time = quote.time;
+				precision = quote.precision;
+				if (Message::fixedPoint()) {
+					scaledPrice = quote.bidPrice.scaled;
+					scaledAskPrice = quote.askPrice.scaled;
+				}
+				else {
+					price = quote.bidPrice.raw;
+					askPrice = quote.askPrice.raw;
+				}
+				size = quote.bidSize;
+				askSize = quote.askSize;
+				conditions[0] = quote.condition;
+			}
+		};
+
+		static const int Capacity = 1024 + 1;
+
+		Message* _rows[Capacity];
+		uint32_t _count;
+
+		static Persistent<Function>& constructor() {
+			static Persistent<Function> constructor;
+			return constructor;
+		}
+
+	public:
+		Records() : _count(0) {}
+
+		// finds the Buffer constructor; once, when the module loads
+		static void initialize() {
+			auto constructor = Context::GetCurrent()->Global()->Get(v8symbol("Buffer"));
+			Records::constructor() = Persistent<Function>::New(constructor.As<Function>());
+		}
+
+		static bool encodes(Message::Type type) {
+			return type == Message::StreamUpdateTrade || type == Message::StreamUpdateQuote;
+		}
+
+		uint32_t count() const {
+			return _count;
+		}
+
+		void add(Message* message) {
+			assert(_count < Capacity && encodes(message->type));
+			_rows[_count++] = message;
+		}
+
+		// the Buffer, tagged with a message name so that it can be dispatched like any other message
+		Handle<Value> value() const {
+			static_assert(sizeof(Record) == 48, "the record layout is part of the format");
+			auto length = HeaderSize + _count * sizeof(Record);
+			Handle<Value> argv[] = { Integer::NewFromUnsigned((uint32_t)length) };
+			auto buffer = constructor()->NewInstance(1, argv);
+			auto data = node::Buffer::Data(buffer);
+
+			Header header = { Magic, Version, sizeof(Record), _count, Message::fixedPoint() ? FixedPoint : 0 };
+			memcpy(data, &header, HeaderSize);
+			auto records = (Record*)(data + HeaderSize);
+			for (uint32_t i = 0; i < _count; ++i) {
+				switch (_rows[i]->type) {
+					case Message::StreamUpdateTrade:
+						records[i].from(*(StreamUpdateTradeMessage*)_rows[i]);
+						break;
+					case Message::StreamUpdateQuote:
+						records[i].from(*(StreamUpdateQuoteMessage*)_rows[i]);
+						break;
+				}
+			}
+
+			v8set(buffer, names::message, Handle<String>(names::streamUpdateRecords));
+			return buffer;
+		}
+
+		void clear() {
+			_count = 0;
+		}
+	};
+}
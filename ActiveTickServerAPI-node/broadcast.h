@@ -0,0 +1,303 @@
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <windows.h>
+
+namespace ActiveTickServerAPI_node {
+
+	// A Broadcast publishes the live stream into named shared memory, for other processes on the box to read.
+	// It is a ring of fixed-size slots, which the producer overwrites lap after lap without waiting for anyone,
+	// and each reader keeps a cursor of its own.  A reader that falls a lap behind is told how much it lost.
+	//
+	// The layout, all little-endian:
+	//	 0	char	magic "ATBQ"
+	//	 4	uint32	version
+	//	 8	uint32	slot size, in bytes
+	//	12	uint32	slot count, a power of 2
+	//	64	uint32	head: how many records have been claimed, modulo 2^32
+	//	128	slots
+	//
+	// Record n goes in slot n % count.  Its sequence is 2n+1 while it's being written, and 2n+2 once written.
+	// A slot:
+	//	 0	uint32	sequence
+	//	 8	uint8	Message::Type: StreamUpdateTrade or StreamUpdateQuote
+	//	 9	uint8	quote condition
+	//	10	char	exchange: the trade's, or the bid's
+	//	11	char	ask exchange
+	//	12	uint8	trade conditions [4]
+	//	16	uint32	trade flags
+	//	20	uint32	size: the trade's, or the bid's
+	//	24	uint32	ask size
+	//	28	uint8	price precision
+	//	29	uint8	ask price precision
+	//	30	uint8	symbol type
+	//	31	uint8	symbol exchange
+	//	32	double	price: the trade's, or the bid's
+	//	40	double	ask price
+	//	48	ATTIME	time: year, month, day of week, day, hour, minute, second, milliseconds as uint16s
+	//	64	uint8	symbol country
+	//	65	char	symbol [31], ASCII and NUL-terminated
+	class Broadcast {
+		Broadcast(const Broadcast&) = delete;
+		Broadcast& operator=(const Broadcast&) = delete;
+
+	public:
+		static const uint32_t Magic = 0x51425441;	// "ATBQ"
+		static const uint32_t Version = 1;
+		static const size_t SymbolLength = 31;
+
+		struct Record {
+			uint8_t type;
+			uint8_t condition;
+			char exchange;
+			char askExchange;
+			uint8_t conditions[4];
+			uint32_t flags;
+			uint32_t size;
+			uint32_t askSize;
+			uint8_t precision;
+			uint8_t askPrecision;
+			uint8_t symbolType;
+			uint8_t symbolExchange;
+			double price;
+			double askPrice;
+			ATTIME time;
+			uint8_t symbolCountry;
+			char symbol[SymbolLength];
+
+			void from(const ATSYMBOL& s) {
+				symbolType = (uint8_t)s.symbolType;
+				symbolExchange = (uint8_t)s.exchangeType;
+				symbolCountry = (uint8_t)s.countryType;
+				size_t i = 0;
+				for (; i < SymbolLength - 1 && s.symbol[i]; ++i)
+					symbol[i] = (char)s.symbol[i];
+				memset(symbol + i, 0, SymbolLength - i);
+			}
+
+			void to(ATSYMBOL& s) const {
+				memset(&s, 0, sizeof(s));
+				s.symbolType = (ATSymbolType)symbolType;
+				s.exchangeType = (ATExchangeType)symbolExchange;
+				s.countryType = (ATCountryType)symbolCountry;
+				for (size_t i = 0; i < SymbolLength && symbol[i]; ++i)
+					s.symbol[i] = symbol[i];
+			}
+
+			void from(const ATQUOTESTREAM_TRADE_UPDATE& trade) {
+				memset(this, 0, sizeof(*this));
+				type = Message::StreamUpdateTrade;
+				from(trade.symbol);
+				exchange = (char)trade.lastExchange;
+				for (int i = 0; i < ATTradeConditionsCount && i < 4; ++i)
+					conditions[i] = (uint8_t)trade.condition[i];
+				flags = (uint32_t)trade.flags;
+				size = trade.lastSize;
+				price = trade.lastPrice.price;
+				precision = trade.lastPrice.precision;
+				time = trade.lastDateTime;
+			}
+
+			void to(ATQUOTESTREAM_TRADE_UPDATE& trade) const {
+				memset(&trade, 0, sizeof(trade));
+				to(trade.symbol);
+				trade.lastExchange = (ATExchangeType)exchange;
+				for (int i = 0; i < ATTradeConditionsCount && i < 4; ++i)
+					trade.condition[i] = (ATTradeConditionType)conditions[i];
+				trade.flags = (ATTradeMessageFlags)flags;
+				trade.lastSize = size;
+				trade.lastPrice.price = price;
+				trade.lastPrice.precision = precision;
+				trade.lastDateTime = time;
+			}
+
+			void from(const ATQUOTESTREAM_QUOTE_UPDATE& quote) {
+				memset(this, 0, sizeof(*this));
+				type = Message::StreamUpdateQuote;
+				from(quote.symbol);
+				condition = (uint8_t)quote.condition;
+				exchange = (char)quote.bidExchange;
+				askExchange = (char)quote.askExchange;
+				size = quote.bidSize;
+				askSize = quote.askSize;
+				price = quote.bidPrice.price;
+				precision = quote.bidPrice.precision;
+				askPrice = quote.askPrice.price;
+				askPrecision = quote.askPrice.precision;
+				time = quote.quoteDateTime;
+			}
+
+			void to(ATQUOTESTREAM_QUOTE_UPDATE& quote) const {
+				memset(&quote, 0, sizeof(quote));
+				to(quote.symbol);
+				quote.condition = (ATQuoteConditionType)condition;
+				quote.bidExchange = (ATExchangeType)exchange;
+				quote.askExchange = (ATExchangeType)askExchange;
+				quote.bidSize = size;
+				quote.askSize = askSize;
+				quote.bidPrice.price = price;
+				quote.bidPrice.precision = precision;
+				quote.askPrice.price = askPrice;
+				quote.askPrice.precision = askPrecision;
+				quote.quoteDateTime = time;
+			}
+		};
+
+	private:
+		// 32-bit sequences, so that readers never need an interlocked instruction on their read-only view
+		struct Slot {
+			std::atomic<uint32_t> sequence;
+			uint32_t reserved;
+			Record record;
+		};
+
+		struct Layout {
+			uint32_t magic;
+			uint32_t version;
+			uint32_t slotSize;
+			uint32_t slotCount;
+			char pad0[64 - 4 * sizeof(uint32_t)];
+			std::atomic<uint32_t> head;
+			char pad1[64 - sizeof(uint32_t)];
+			Slot slots[1];
+		};
+
+		static const size_t LayoutSize = 128;
+
+		static inline std::string mappingName(const std::string& name) {
+			return name.find('\\') == std::string::npos ? "Local\\" + name : name;
+		}
+
+		// sequence numbers wrap, so compare them by their difference
+		static inline int32_t compare(uint32_t a, uint32_t b) {
+			return (int32_t)(a - b);
+		}
+
+		HANDLE _mapping;
+		Layout* _layout;
+		uint32_t _mask;
+
+	public:
+		// creates the named mapping, or takes over one left by an earlier producer
+		Broadcast(const std::string& name, uint32_t slots) : _mapping(NULL), _layout(NULL), _mask(0) {
+			static_assert(sizeof(Slot) == 96, "the slot layout is part of the format");
+			if (!slots || (slots & (slots - 1)))
+				return;
+
+			uint64_t size = LayoutSize + (uint64_t)slots * sizeof(Slot);
+			_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, mappingName(name).c_str());
+			if (!_mapping)
+				return;
+			_layout = (Layout*)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+			if (!_layout)
+				return;
+
+			// a new mapping reads as all zeroes, so every slot is waiting for its first record
+			if (_layout->magic == Magic && (_layout->version != Version || _layout->slotSize != sizeof(Slot) || _layout->slotCount != slots)) {
+				UnmapViewOfFile(_layout);
+				_layout = NULL;
+				return;
+			}
+			_layout->version = Version;
+			_layout->slotSize = sizeof(Slot);
+			_layout->slotCount = slots;
+			std::atomic_thread_fence(std::memory_order_release);
+			_layout->magic = Magic;
+			_mask = slots - 1;
+		}
+
+		~Broadcast() {
+			if (_layout)
+				UnmapViewOfFile(_layout);
+			if (_mapping)
+				CloseHandle(_mapping);
+		}
+
+		inline bool open() const {
+			return _layout != NULL;
+		}
+
+		// never waits, no matter how far behind the readers are
+		template<typename T> void publish(const T& update) {
+			auto n = _layout->head.fetch_add(1, std::memory_order_relaxed);
+			auto& slot = _layout->slots[n & _mask];
+			slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.record.from(update);
+			slot.sequence.store(2 * n + 2, std::memory_order_release);
+		}
+
+		// A Reader attaches to a Broadcast from any process, and reads it from wherever the producer has got to
+		class Reader {
+			Reader(const Reader&) = delete;
+			Reader& operator=(const Reader&) = delete;
+
+			HANDLE _mapping;
+			const Layout* _layout;
+			uint32_t _mask;
+			uint32_t _cursor;
+
+		public:
+			enum Status {
+				Empty,		// nothing new yet
+				Ready,		// a record was read
+				Lapped,		// records were overwritten before we got to them, and we've skipped ahead
+			};
+
+			Reader(const std::string& name) : _mapping(NULL), _layout(NULL), _mask(0), _cursor(0) {
+				_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName(name).c_str());
+				if (!_mapping)
+					return;
+				_layout = (const Layout*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+				if (!_layout)
+					return;
+				if (_layout->magic != Magic || _layout->version != Version || _layout->slotSize != sizeof(Slot)) {
+					UnmapViewOfFile(_layout);
+					_layout = NULL;
+					return;
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				_mask = _layout->slotCount - 1;
+				_cursor = _layout->head.load(std::memory_order_acquire);
+			}
+
+			~Reader() {
+				if (_layout)
+					UnmapViewOfFile(_layout);
+				if (_mapping)
+					CloseHandle(_mapping);
+			}
+
+			inline bool open() const {
+				return _layout != NULL;
+			}
+
+			// when Lapped, 'lost' says how many records were skipped
+			Status read(Record& record, uint32_t& lost) {
+				auto& slot = _layout->slots[_cursor & _mask];
+				uint32_t expected = 2 * _cursor + 2;
+				auto sequence = slot.sequence.load(std::memory_order_acquire);
+				if (compare(sequence, expected) < 0)
+					return Empty;
+
+				if (sequence == expected) {
+					memcpy(&record, (const void*)&slot.record, sizeof(Record));
+					// if the producer came round again while we were copying, what we have is torn
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (slot.sequence.load(std::memory_order_relaxed) == expected) {
+						++_cursor;
+						return Ready;
+					}
+				}
+
+				// skip to the oldest record still there, and a little past it, so we aren't lapped again straight away
+				auto head = _layout->head.load(std::memory_order_acquire);
+				auto oldest = head - (_mask + 1) + (_mask + 1) / 8;
+				lost = oldest - _cursor;
+				_cursor = oldest;
+				return Lapped;
+			}
+		};
+	};
+
+}
@@ -0,0 +1,169 @@
+#include <atomic>
+
+namespace ActiveTickServerAPI_node {
+
+	// Exchange times, which the API gives as America/New_York wall-clock times, to and from milliseconds since the epoch.
+	// It's plain arithmetic on the civil calendar, with the zone's daylight saving transitions worked out once, by year,
+	// so the answer doesn't depend on the process's time zone, and any thread may ask.
+	class Calendar {
+		Calendar(const Calendar&) = delete;
+		Calendar& operator=(const Calendar&) = delete;
+
+		// the years whose transitions are in the table, and whose dates can be cached; others are worked out each time
+		static const int FirstYear = 1970;
+		static const int LastYear = 2097;
+
+		static const int64_t MsPerHour = 60 * 60 * 1000;
+		static const int64_t MsPerDay = 24 * MsPerHour;
+
+		// the days since the epoch of the Sundays that daylight time begins and ends, at 2am local time
+		int32_t _begins[LastYear - FirstYear + 1];
+		int32_t _ends[LastYear - FirstYear + 1];
+
+		// The last date converted, as 16 bits of year, month and day, and 16 bits of its days since the epoch.
+		// A tick's date is nearly always the last one's, and a single word can be shared by every thread without tearing.
+		std::atomic<uint32_t> _last;
+
+		static int64_t floorDivide(int64_t n, int64_t d) {
+			return n >= 0 ? n / d : -((-n + d - 1) / d);
+		}
+
+		// 0 for Sunday
+		static int weekday(int32_t days) {
+			return (int)((days % 7 + 11) % 7);
+		}
+
+		// the nth Sunday of the month, or with n of 0, the last
+		static int32_t sunday(int year, int month, int n) {
+			if (n == 0) {
+				auto last = month == 12 ? days(year + 1, 1, 1) - 1 : days(year, month + 1, 1) - 1;
+				return last - weekday(last);
+			}
+			auto first = days(year, month, 1);
+			return first + (7 - weekday(first)) % 7 + 7 * (n - 1);
+		}
+
+		// the rules America/New_York has kept since 1970
+		static void transitions(int year, int32_t& begins, int32_t& ends) {
+			if (year >= 2007) {
+				begins = sunday(year, 3, 2);
+				ends = sunday(year, 11, 1);
+			}
+			else if (year >= 1987) {
+				begins = sunday(year, 4, 1);
+				ends = sunday(year, 10, 0);
+			}
+			else if (year == 1974) {
+				begins = days(1974, 1, 6);
+				ends = sunday(year, 10, 0);
+			}
+			else if (year == 1975) {
+				begins = days(1975, 2, 23);
+				ends = sunday(year, 10, 0);
+			}
+			else {
+				begins = sunday(year, 4, 0);
+				ends = sunday(year, 10, 0);
+			}
+		}
+
+		void transitionsOf(int year, int32_t& begins, int32_t& ends) const {
+			if (year >= FirstYear && year <= LastYear) {
+				begins = _begins[year - FirstYear];
+				ends = _ends[year - FirstYear];
+			}
+			else
+				transitions(year, begins, ends);
+		}
+
+		// whether a wall-clock time is daylight time: the hour skipped in spring counts as standard time still,
+		// and the hour repeated in the fall as daylight time
+		bool daylight(int year, int32_t date, int hour) const {
+			int32_t begins, ends;
+			transitionsOf(year, begins, ends);
+			if (date == begins)
+				return hour >= 3;
+			if (date == ends)
+				return hour < 2;
+			return date > begins && date < ends;
+		}
+
+	public:
+		Calendar() : _last(0) {
+			for (int year = FirstYear; year <= LastYear; ++year)
+				transitions(year, _begins[year - FirstYear], _ends[year - FirstYear]);
+		}
+
+		// days since the epoch of a date in the proleptic Gregorian calendar
+		static int32_t days(int year, int month, int day) {
+			year -= month <= 2;
+			int era = (year >= 0 ? year : year - 399) / 400;
+			int yearOfEra = year - era * 400;
+			int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+			int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+			return era * 146097 + dayOfEra - 719468;
+		}
+
+		static void date(int32_t days, int& year, int& month, int& day) {
+			days += 719468;
+			int era = (days >= 0 ? days : days - 146096) / 146097;
+			int dayOfEra = days - era * 146097;
+			int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+			int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+			int m = (5 * dayOfYear + 2) / 153;
+			day = dayOfYear - (153 * m + 2) / 5 + 1;
+			month = m < 10 ? m + 3 : m - 9;
+			year = yearOfEra + era * 400 + (month <= 2);
+		}
+
+		// Milliseconds since the epoch.
+		// The hour from 1am repeated when daylight time ends names two instants an hour apart, with nothing in an ATTIME
+		// to tell them apart, so it's taken as the first, in EDT: a tick in the second, in EST, comes out an hour early.
+		double epoch(const ATTIME& time) {
+			int32_t date;
+			bool cacheable = time.year >= FirstYear && time.year <= LastYear;
+			uint32_t key = (uint32_t)(time.year - FirstYear) << 9 | (time.month & 0xf) << 5 | (time.day & 0x1f);
+			auto last = _last.load(std::memory_order_relaxed);
+			if (cacheable && last >> 16 == key)
+				date = (int32_t)(last & 0xffff);
+			else {
+				date = days(time.year, time.month, time.day);
+				if (cacheable)
+					_last.store(key << 16 | (uint32_t)date, std::memory_order_relaxed);
+			}
+
+			auto offset = daylight(time.year, date, time.hour) ? 4 * MsPerHour : 5 * MsPerHour;
+			auto ms = date * MsPerDay + ((time.hour * 60 + time.minute) * 60 + time.second) * 1000LL + time.milliseconds + offset;
+			return (double)ms;
+		}
+
+		// the wall-clock time of an instant
+		ATTIME time(int64_t ms) const {
+			int32_t begins, ends;
+			auto local = ms - 5 * MsPerHour;
+			int year, month, day;
+			date((int32_t)floorDivide(local, MsPerDay), year, month, day);
+			// daylight time begins at 2am standard time, and ends at 2am daylight time
+			transitionsOf(year, begins, ends);
+			if (ms >= begins * MsPerDay + 7 * MsPerHour && ms < ends * MsPerDay + 6 * MsPerHour)
+				local += MsPerHour;
+
+			auto today = (int32_t)floorDivide(local, MsPerDay);
+			auto ofDay = local - today * MsPerDay;
+			date(today, year, month, day);
+
+			ATTIME time;
+			time.year = (uint16_t)year;
+			time.month = (uint16_t)month;
+			time.dayOfWeek = (uint16_t)weekday(today);
+			time.day = (uint16_t)day;
+			time.hour = (uint16_t)(ofDay / MsPerHour);
+			time.minute = (uint16_t)(ofDay / 60000 % 60);
+			time.second = (uint16_t)(ofDay / 1000 % 60);
+			time.milliseconds = (uint16_t)(ofDay % 1000);
+			return time;
+		}
+	};
+
+	static Calendar calendar;
+}
@@ -0,0 +1,142 @@
+// A standalone driver for the calendar: it checks Calendar against the C library's own America/New_York conversions,
+// and times both, as the addon converts every tick's time.  It isn't part of the addon; build it on its own, optimized, e.g.
+//	cl /EHsc /O2 /I<ActiveTick SDK include> calendarbench.cpp
+// and run it as
+//	calendarbench [conversions]
+// The C library's rules for the zone only go back as far as it knows them; with TZ=EST5EDT, the Microsoft one
+// applies today's rules to every year, so the check starts in 2007, when they came in.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <ActiveTickServerAPI.h>
+#include "calendar.h"
+
+using namespace ActiveTickServerAPI_node;
+
+#ifdef _MSC_VER
+static void newYork() {
+	_putenv_s("TZ", "EST5EDT");
+	_tzset();
+}
+
+static void local(time_t seconds, tm& time) {
+	localtime_s(&time, &seconds);
+}
+#else
+static void newYork() {
+	setenv("TZ", "America/New_York", 1);
+	tzset();
+}
+
+static void local(time_t seconds, tm& time) {
+	localtime_r(&seconds, &time);
+}
+#endif
+
+static ATTIME attime(const tm& time, int milliseconds) {
+	ATTIME result;
+	result.year = (uint16_t)(time.tm_year + 1900);
+	result.month = (uint16_t)(time.tm_mon + 1);
+	result.dayOfWeek = (uint16_t)time.tm_wday;
+	result.day = (uint16_t)time.tm_mday;
+	result.hour = (uint16_t)time.tm_hour;
+	result.minute = (uint16_t)time.tm_min;
+	result.second = (uint16_t)time.tm_sec;
+	result.milliseconds = (uint16_t)milliseconds;
+	return result;
+}
+
+// what the addon did before Calendar
+static double viaMktime(const ATTIME& time) {
+	tm t = {};
+	t.tm_year = time.year - 1900;
+	t.tm_mon = time.month - 1;
+	t.tm_mday = time.day;
+	t.tm_hour = time.hour;
+	t.tm_min = time.minute;
+	t.tm_sec = time.second;
+	t.tm_isdst = -1;
+	return (double)mktime(&t) * 1000 + time.milliseconds;
+}
+
+static bool same(const ATTIME& a, const ATTIME& b) {
+	return a.year == b.year && a.month == b.month && a.dayOfWeek == b.dayOfWeek && a.day == b.day
+		&& a.hour == b.hour && a.minute == b.minute && a.second == b.second && a.milliseconds == b.milliseconds;
+}
+
+// every 557 seconds from 2007 through 2037, both ways; returns the mismatches
+static long check() {
+	long checked = 0, mismatches = 0;
+	for (int64_t seconds = 1167609600; seconds < 2145916800; seconds += 557) {
+		tm lt;
+		local((time_t)seconds, lt);
+		auto expected = attime(lt, 123);
+		auto ms = seconds * 1000 + 123;
+		++checked;
+
+		if (!same(calendar.time(ms), expected)) {
+			if (++mismatches <= 5)
+				printf("time(%lld) differs\n", (long long)ms);
+		}
+
+		// the hour repeated in the fall names two instants, and epoch() takes the first, in daylight time
+		auto epoch = calendar.epoch(expected);
+		bool repeated = !lt.tm_isdst && expected.hour == 1 && epoch == ms - 60 * 60 * 1000;
+		if (epoch != ms && !repeated) {
+			if (++mismatches <= 5)
+				printf("epoch(%04d-%02d-%02d %02d:%02d:%02d) differs\n",
+					expected.year, expected.month, expected.day, expected.hour, expected.minute, expected.second);
+		}
+	}
+	printf("checked %ld instants, %ld mismatches\n", checked, mismatches);
+	return mismatches;
+}
+
+int main(int argc, char** argv) {
+	long count = argc > 1 ? atol(argv[1]) : 10000000;
+	newYork();
+	if (check())
+		return 1;
+
+	// a burst of ticks a few ms apart, as a feed gives them, so the date is nearly always the last one's
+	static ATTIME times[1024];
+	for (int i = 0; i < 1024; ++i)
+		times[i] = calendar.time(1500000000000LL + i * 37LL);
+	auto start = 1500000000000LL;
+
+	printf("%ld conversions each, best of 3\n", count);
+	double best[4] = { 1e300, 1e300, 1e300, 1e300 };
+	volatile double sink = 0;
+	for (int round = 0; round < 3; ++round) {
+		std::chrono::steady_clock::time_point t[5];
+		t[0] = std::chrono::steady_clock::now();
+		for (long i = 0; i < count; ++i)
+			sink = sink + viaMktime(times[i & 1023]);
+		t[1] = std::chrono::steady_clock::now();
+		for (long i = 0; i < count; ++i)
+			sink = sink + calendar.epoch(times[i & 1023]);
+		t[2] = std::chrono::steady_clock::now();
+		for (long i = 0; i < count; ++i) {
+			tm lt;
+			local((time_t)((start + i) / 1000), lt);
+			sink = sink + lt.tm_hour;
+		}
+		t[3] = std::chrono::steady_clock::now();
+		for (long i = 0; i < count; ++i)
+			sink = sink + calendar.time(start + i).hour;
+		t[4] = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < 4; ++i) {
+			auto ns = std::chrono::duration<double, std::nano>(t[i + 1] - t[i]).count() / count;
+			if (ns < best[i])
+				best[i] = ns;
+		}
+	}
+	printf("mktime          %7.1f ns\n", best[0]);
+	printf("Calendar::epoch %7.1f ns\n", best[1]);
+	printf("localtime       %7.1f ns\n", best[2]);
+	printf("Calendar::time  %7.1f ns\n", best[3]);
+	return 0;
+}
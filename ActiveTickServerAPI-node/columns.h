@@ -0,0 +1,128 @@
+namespace ActiveTickServerAPI_node {
+	using namespace v8;
+
+	// A typed array, made with the script's own constructor, whose elements are written in place
+	template<typename T> class Column {
+		static Persistent<Function>& constructor() {
+			static Persistent<Function> constructor;
+			return constructor;
+		}
+
+		static const char* name();
+
+	public:
+		static void initialize() {
+			auto constructor = Context::GetCurrent()->Global()->Get(v8symbol(name()));
+			Column::constructor() = Persistent<Function>::New(constructor.As<Function>());
+		}
+
+		// a column of 'count' elements, set as a field of 'batch'
+		static T* add(Handle<Object> batch, Handle<String> field, uint32_t count) {
+			Handle<Value> argv[] = { Integer::NewFromUnsigned(count) };
+			auto column = constructor()->NewInstance(1, argv);
+			v8set(batch, field, column);
+			return (T*)column->GetIndexedPropertiesExternalArrayData();
+		}
+	};
+
+	template<> inline const char* Column<double>::name() { return "Float64Array"; }
+	template<> inline const char* Column<uint32_t>::name() { return "Uint32Array"; }
+	template<> inline const char* Column<uint8_t>::name() { return "Uint8Array"; }
+
+	// finds the typed array constructors; once, when the module loads
+	inline void initializeColumns() {
+		Column<double>::initialize();
+		Column<uint32_t>::initialize();
+		Column<uint8_t>::initialize();
+	}
+
+	// The trades or quotes popped for one callback, delivered as a single object of columns instead of an object apiece.
+	// The messages are held, in the queue, until the callback has been made; then clear() lets them go.
+	template<typename M> class Columns {
+		static const int Capacity = 1024 + 1;
+
+		M* _rows[Capacity];
+		int _count;
+
+	public:
+		Columns() : _count(0) {}
+
+		int count() const {
+			return _count;
+		}
+
+		void add(M* message) {
+			assert(_count < Capacity);
+			_rows[_count++] = message;
+		}
+
+		// one column for each field, one row for each message; symbols by their number in the module's table,
+		// conditions as the same bitmask a message has, in a Float64Array since it reaches past 32 bits,
+		// and with fixedPoint, prices as integers, exact in a Float64Array, beside a column of their precisions
+		Handle<Value> value() const;
+
+		void clear() {
+			_count = 0;
+		}
+	};
+
+	template<> inline Handle<Value> Columns<StreamUpdateTradeMessage>::value() const {
+		auto batch = Object::New();
+		v8set(batch, names::message, Handle<String>(names::streamUpdateTrades));
+		v8set(batch, names::count, _count);
+		auto symbol = Column<uint32_t>::add(batch, names::symbol, _count);
+		auto time = Column<double>::add(batch, names::time, _count);
+		auto lastPrice = Column<double>::add(batch, names::lastPrice, _count);
+		auto lastSize = Column<uint32_t>::add(batch, names::lastSize, _count);
+		auto lastExchange = Column<uint8_t>::add(batch, names::lastExchange, _count);
+		auto conditions = Column<double>::add(batch, names::conditions, _count);
+		auto flags = Column<uint32_t>::add(batch, names::flags, _count);
+		auto precision = Message::fixedPoint() ? Column<uint8_t>::add(batch, names::precision, _count) : NULL;
+
+		for (int i = 0; i < _count; ++i) {
+			auto& trade = *_rows[i];
+			symbol[i] = trade.symbolId;
+			time[i] = trade.time;
+			lastPrice[i] = Message::price(trade.lastPrice);
+			if (precision)
+				precision[i] = trade.precision;
+			lastSize[i] = trade.lastSize;
+			lastExchange[i] = trade.lastExchange;
+			conditions[i] = (double)trade.conditionBits();
+			flags[i] = trade.flags;
+		}
+		return batch;
+	}
+
+	template<> inline Handle<Value> Columns<StreamUpdateQuoteMessage>::value() const {
+		auto batch = Object::New();
+		v8set(batch, names::message, Handle<String>(names::streamUpdateQuotes));
+		v8set(batch, names::count, _count);
+		auto symbol = Column<uint32_t>::add(batch, names::symbol, _count);
+		auto time = Column<double>::add(batch, names::time, _count);
+		auto bidPrice = Column<double>::add(batch, names::bidPrice, _count);
+		auto bidSize = Column<uint32_t>::add(batch, names::bidSize, _count);
+		auto bidExchange = Column<uint8_t>::add(batch, names::bidExchange, _count);
+		auto askPrice = Column<double>::add(batch, names::askPrice, _count);
+		auto askSize = Column<uint32_t>::add(batch, names::askSize, _count);
+		auto askExchange = Column<uint8_t>::add(batch, names::askExchange, _count);
+		auto conditions = Column<double>::add(batch, names::conditions, _count);
+		auto precision = Message::fixedPoint() ? Column<uint8_t>::add(batch, names::precision, _count) : NULL;
+
+		for (int i = 0; i < _count; ++i) {
+			auto& quote = *_rows[i];
+			symbol[i] = quote.symbolId;
+			time[i] = quote.time;
+			bidPrice[i] = Message::price(quote.bidPrice);
+			if (precision)
+				precision[i] = quote.precision;
+			bidSize[i] = quote.bidSize;
+			bidExchange[i] = quote.bidExchange;
+			askPrice[i] = Message::price(quote.askPrice);
+			askSize[i] = quote.askSize;
+			askExchange[i] = quote.askExchange;
+			conditions[i] = (double)quote.conditionBits();
+		}
+		return batch;
+	}
+}
@@ -10,6 +10,11 @@ namespace ActiveTickServerAPI_node {
 		bad_data() : std::exception("bad data", 1) {}
 	};
 
+	class symbol_table_full : public std::exception {
+	public:
+		symbol_table_full() : std::exception("symbol table full", 1) {}
+	};
+
 	class request_timeout : public std::exception {
 	public:
 		request_timeout() : std::exception("request timeout", 1) {}
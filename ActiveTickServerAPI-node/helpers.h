@@ -20,36 +20,105 @@ inline v8::Handle<v8::Value> v8date(double value) { return v8::Date::New(value);
 inline v8::Handle<v8::Value> v8error(const char* msg) { return v8::Exception::Error(v8string(msg)); }
 inline v8::Handle<v8::Value> v8throw(const char* msg) { return v8::ThrowException(v8error(msg)); }
 
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, v8::Handle<v8::Value> value) {
+	return object->Set(name, value);
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, const char* value) {
+	return v8set(object, name, v8string(value));
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, const wchar_t* value) {
+	return v8set(object, name, v8string(value));
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, uint64_t value) {
+	return v8set(object, name, v8string(value));
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, uint64_t value1, uint64_t value2) {
+	return v8set(object, name, v8string(value1, value2));
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, double value) {
+	return v8set(object, name, v8number(value));
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, int value) {
+	return v8set(object, name, v8number(value));
+}
+inline bool v8set(v8::Handle<v8::Object> object, v8::Handle<v8::String> name, unsigned int value) {
+	return v8set(object, name, v8number(value));
+}
+
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, v8::Handle<v8::Value> value) {
-	return object->Set(v8symbol(name), value);
+	return v8set(object, v8symbol(name), value);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, const char* value) {
-	return v8set(object, name, v8string(value));
+	return v8set(object, v8symbol(name), value);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, const wchar_t* value) {
-	return v8set(object, name, v8string(value));
+	return v8set(object, v8symbol(name), value);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, v8::InvocationCallback callback) {
 	return v8set(object, name, v8::FunctionTemplate::New(callback)->GetFunction());
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, uint64_t value) {
-	return v8set(object, name, v8string(value));
+	return v8set(object, v8symbol(name), value);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, uint64_t value1, uint64_t value2) {
-	return v8set(object, name, v8string(value1, value2));
+	return v8set(object, v8symbol(name), value1, value2);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, double value) {
-	return v8set(object, name, v8number(value));
+	return v8set(object, v8symbol(name), value);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, int value) {
-	return v8set(object, name, v8number(value));
+	return v8set(object, v8symbol(name), value);
 }
 inline bool v8set(v8::Handle<v8::Object> object, const char* name, unsigned int value) {
-	return v8set(object, name, v8number(value));
+	return v8set(object, v8symbol(name), value);
 }
 
+inline bool v8flag(v8::Handle<v8::Object> object, v8::Handle<v8::String> name) {
+	if (!name.IsEmpty())
+		return v8set(object, name, v8::True());
+	return false;
+}
 inline bool v8flag(v8::Handle<v8::Object> object, const char* name) {
 	if (name)
 		return v8set(object, name, v8::True());
 	return false;
-}
\ No newline at end of file
+}
+
+// Writes value / 10^precision as an exact decimal, two digits at a time, with 'precision' digits after the point;
+// 'buffer' needs room for 22 characters, and 'precision' may be at most 18.  Returns the length.
+inline int formatDecimal(char* buffer, int64_t value, int precision) {
+	static const char pairs[] =
+		"0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+		"5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+	char digits[20];
+	auto end = digits + sizeof(digits), p = end;
+	uint64_t n = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+	while (n >= 100) {
+		auto pair = pairs + 2 * (n % 100);
+		n /= 100;
+		*--p = pair[1];
+		*--p = pair[0];
+	}
+	if (n >= 10) {
+		*--p = pairs[2 * n + 1];
+		*--p = pairs[2 * n];
+	}
+	else
+		*--p = (char)('0' + n);
+	while (end - p < precision + 1)
+		*--p = '0';
+
+	auto out = buffer;
+	if (value < 0)
+		*out++ = '-';
+	auto whole = (int)(end - p) - precision;
+	memcpy(out, p, whole);
+	out += whole;
+	if (precision) {
+		*out++ = '.';
+		memcpy(out, p + whole, precision);
+		out += precision;
+	}
+	*out = 0;
+	return (int)(out - buffer);
+}
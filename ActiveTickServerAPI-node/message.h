@@ -1,10 +1,144 @@
-#include <time.h>
+#include <math.h>
+#include <initializer_list>
+#include <type_traits>
 
 namespace ActiveTickServerAPI_node {
 	using namespace v8;
 
+	// A string made once, when the module loads, and kept for good,
+	// rather than looked up afresh for every field of every message
+	class Name {
+		Name(const Name&) = delete;
+		Name& operator=(const Name&) = delete;
+
+		const char* _name;
+		Persistent<String> _string;
+		Name* _next;
+
+		static Name*& first() {
+			static Name* name = NULL;
+			return name;
+		}
+
+	public:
+		Name(const char* name) : _name(name), _next(first()) {
+			first() = this;
+		}
+
+		inline operator Handle<String>() const {
+			return _string;
+		}
+
+		static void intern() {
+			for (auto name = first(); name; name = name->_next)
+				name->_string = Persistent<String>::New(String::NewSymbol(name->_name));
+		}
+	};
+
+	namespace names {
+		static Name message("message");
+		static Name request("request");
+		static Name session("session");
+		static Name end("end");
+		static Name error("error");
+		static Name success("success");
+		static Name records("records");
+		static Name sessionStatus("sessionStatus");
+		static Name loginResponse("loginResponse");
+		static Name serverTime("serverTime");
+		static Name streamResponse("streamResponse");
+		static Name symbol("symbol");
+		static Name symbolId("symbolId");
+		static Name precision("precision");
+		static Name symbolStatus("symbolStatus");
+		static Name time("time");
+		static Name lastPrice("lastPrice");
+		static Name lastSize("lastSize");
+		static Name lastExchange("lastExchange");
+		static Name bidPrice("bidPrice");
+		static Name bidSize("bidSize");
+		static Name bidExchange("bidExchange");
+		static Name askPrice("askPrice");
+		static Name askSize("askSize");
+		static Name askExchange("askExchange");
+		static Name volume("volume");
+		static Name openPrice("openPrice");
+		static Name highPrice("highPrice");
+		static Name lowPrice("lowPrice");
+		static Name closePrice("closePrice");
+		static Name prevClosePrice("prevClosePrice");
+		static Name afterMarketClosePrice("afterMarketClosePrice");
+		static Name exchanges("exchanges");
+		static Name begins("begins");
+		static Name ends("ends");
+		static Name barHistoryResponse("barHistoryResponse");
+		static Name open("open");
+		static Name high("high");
+		static Name low("low");
+		static Name close("close");
+		static Name regularMarketLastPrice("regularMarketLastPrice");
+		static Name regularMarketVolume("regularMarketVolume");
+		static Name dayHighPrice("dayHighPrice");
+		static Name dayLowPrice("dayLowPrice");
+		static Name extendedMarketLastPrice("extendedMarketLastPrice");
+		static Name preMarketVolume("preMarketVolume");
+		static Name afterMarketVolume("afterMarketVolume");
+		static Name preMarketOpenPrice("preMarketOpenPrice");
+		static Name subscribed("subscribed");
+		static Name unsubscribed("unsubscribed");
+		static Name lapped("lapped");
+		static Name lost("lost");
+		static Name flags("flags");
+		static Name detach("detach");
+		static Name count("count");
+		static Name symbols("symbols");
+		static Name conditions("conditions");
+		static Name quoteConditions("quoteConditions");
+		static Name streamUpdateTrades("stream-update-trades");
+		static Name streamUpdateQuotes("stream-update-quotes");
+		static Name streamUpdateRecords("stream-update-records");
+	}
+
+	// The strings that the values of an enum convert to, each made once, when the module loads.
+	// A value that converts to NULL has an empty handle.
+	template<typename T> class Strings {
+		static const size_t Count = 256;
+
+		const char* (*_convert)(T);
+		Persistent<String> _strings[Count];
+
+	public:
+		Strings() : _convert(NULL) {}
+
+		void intern(const char* (*convert)(T)) {
+			_convert = convert;
+			for (size_t i = 0; i < Count; ++i)
+				if (auto string = convert((T)i))
+					_strings[i] = Persistent<String>::New(String::NewSymbol(string));
+		}
+
+		// the whole table, indexed by value
+		Handle<Array> array() const {
+			auto array = Array::New(Count);
+			for (size_t i = 0; i < Count; ++i)
+				if (!_strings[i].IsEmpty())
+					array->Set(i, _strings[i]);
+			return array;
+		}
+
+		inline Handle<String> operator[](T value) const {
+			if ((size_t)value < Count)
+				return _strings[(size_t)value];
+			// beyond the table, which only a new version of the API could send
+			auto string = _convert(value);
+			return string ? v8symbol(string) : Handle<String>();
+		}
+	};
+
+	// Messages are plain records, tagged by their type, with no vtable: nothing to destroy, so a queue can let go of them wholesale,
+	// and each is marshaled by a switch on its type, to the member of its own struct that hides Message's.
 	struct Message {
-		enum Type {
+		enum Type : uint8_t {
 			None,
 			Error,
 			Success,
@@ -28,14 +162,15 @@ namespace ActiveTickServerAPI_node {
 			BarHistory,
 		};
 
+		static const int TypeCount = BarHistory + 1;
+
 		Type type;
+		bool end;
 		uint64_t session;
+		// the API's request id, until the message is popped; then the request's handle, as scripts know it
 		uint64_t request;
-		bool end;
-
-		Message() : type(None), session(0), request(0) {}
 
-		virtual ~Message() {}
+		Message() : type(None), end(false), session(0), request(0) {}
 
 		static void* operator new(size_t size, Queue &q) {
 			return q.allocate(size);
@@ -45,83 +180,318 @@ namespace ActiveTickServerAPI_node {
 			q.release(p);
 		}
 
-		virtual Handle<Value> value() {
-			auto value = Object::New();
-			set(value, "message", type);
+		static void* operator new(size_t size, Queue::Batch &batch) {
+			return batch.allocate(size);
+		}
+
+		static void operator delete(void* p, Queue::Batch &batch) {
+			batch.discard(p);
+		}
+
+		// makes every name and enum string that messages use; before any message's value() is taken
+		static void intern();
+
+		// the number of a message's symbol, which the producer stamps on it, adding the symbol to the table if need be;
+		// producers ask before they claim room in a queue, so that a full table leaves nothing half-made behind
+		static inline uint32_t number(const ATSYMBOL& symbol) {
+			auto id = symbolTable.add(symbol.symbol);
+			if (!id)
+				throw symbol_table_full();
+			return id;
+		}
+
+		// the tables that turn exchange and condition codes, and trade flag bits, into names, for scripts
+		static void tables(Handle<Object> exports);
+
+		// Conditions come as a bitmask, bit n for condition code n, as named by the module's tradeConditions or quoteConditions.
+		// There are more than 32 of them, so it is a plain number, which holds 53 bits exactly.
+		// Flags come as a bitmask too, named bit by bit by the module's tradeFlags.
+		// With booleanFlags, flags is instead the object of booleans that both used to be, or null when there are none.
+		static bool& booleanFlags() {
+			static bool booleanFlags = false;
+			return booleanFlags;
+		}
+
+		// times as milliseconds since the epoch, and prices as plain numbers, however a message is delivered
+		static double convert(const ATTIME& time) {
+			return calendar.epoch(time);
+		}
+
+		static double convert(const ATPRICE& price) {
+			return price.price;
+		}
+
+		// Stream trades and quotes keep their prices just as the API gives them, as plain numbers;
+		// with fixedPoint, they keep and deliver them as integers in units of 10^-precision, exact up to 2^53, alongside a precision field.
+		static bool& fixedPoint() {
+			static bool fixedPoint = false;
+			return fixedPoint;
+		}
+
+		static const uint8_t MaxPrecision = 9;
+
+		static inline double powerOf10(uint8_t precision) {
+			static const double powers[MaxPrecision + 1] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+			return powers[precision];
+		}
+
+		static inline uint8_t precisionOf(const ATPRICE& price) {
+			return price.precision < MaxPrecision ? price.precision : MaxPrecision;
+		}
+
+		union Price {
+			double raw;
+			int64_t scaled;
+		};
+
+		static inline Price price(const ATPRICE& price, uint8_t precision) {
+			Price stored;
+			if (fixedPoint())
+				stored.scaled = llround(price.price * powerOf10(precision));
+			else
+				stored.raw = price.price;
+			return stored;
+		}
+
+		static inline double price(Price price) {
+			return fixedPoint() ? (double)price.scaled : price.raw;
+		}
+
+		static inline Handle<Value> precisionValue(uint8_t precision) {
+			if (!fixedPoint())
+				return Undefined();
+			return v8number(precision);
+		}
+
+		Handle<Value> value() {
+			auto value = boilerplate(type)->Clone();
 			populate(value);
 			if (request)
-				v8set(value, "request", session, request);
+				v8set(value, names::request, (double)request);
 			else if (session)
-				v8set(value, "session", session);
+				v8set(value, names::session, session);
 			if (end)
-				v8flag(value, "end");
+				v8flag(value, names::end);
 			return value;
 		}
 
+		// Only the stream updates, the bulk of the traffic, can be delivered lazily:
+		// as a thin object whose fields are read from the message only when they're touched.
+		static bool lazilyDelivered(Type type) {
+			return type == StreamUpdateTrade || type == StreamUpdateQuote || type == StreamUpdateRefresh;
+		}
+
+		// The lazy object can only read the message while it's alive, so whoever delivers it must release it first.
+		// detach() makes a plain copy, that lasts, and releases it too.
+		Handle<Object> lazy() {
+			auto value = lazyTemplate(type)->NewInstance();
+			value->SetPointerInInternalField(0, this);
+			return value;
+		}
+
+		static Message* release(Handle<Object> lazy) {
+			auto message = (Message*)lazy->GetPointerFromInternalField(0);
+			lazy->SetPointerInInternalField(0, NULL);
+			return message;
+		}
+
+		// messages with the same non-zero key supersede one another, when a queue conflates:
+		// the latest quote or refresh of a symbol stands for the ones before it, but a trade is an event, and has no key
+		uint64_t key() const;
+
 	protected:
 		Message(Type type, uint64_t session = 0, uint64_t request = 0, bool end = false) : 
 			type(type),
+			end(end),
 			session(session),
-			request(request),
-			end(end)
+			request(request)
 		{}
 
-		virtual void populate(Handle<Object> value) {}
+		void populate(Handle<Object> value);
+
+		// one field, by name, for a lazy object
+		Handle<Value> field(const Name& name);
+
+		// the fields every message has
+		Handle<Value> header(const Name& name) const {
+			if (&name == &names::message)
+				return types()[type];
+			if (&name == &names::request && request)
+				return v8number((double)request);
+			if (&name == &names::session && session && !request)
+				return v8string(session);
+			if (&name == &names::end)
+				return Boolean::New(end);
+			return Undefined();
+		}
+
+		// Every message of a type is a clone of the same boilerplate, which already has all of the type's fields,
+		// in order, so that they all share one hidden class and the handlers that read them stay monomorphic.
+		// A field that a message doesn't fill in is left undefined.
+		static Persistent<Object>& boilerplate(Type type) {
+			static Persistent<Object> boilerplates[TypeCount];
+			return boilerplates[type];
+		}
+
+		static Persistent<ObjectTemplate>& lazyTemplate(Type type) {
+			static Persistent<ObjectTemplate> templates[TypeCount];
+			return templates[type];
+		}
+
+		static void define(Type type, std::initializer_list<const Name*> fields) {
+			auto value = Object::New();
+			set(value, names::message, type);
+			v8set(value, names::request, Undefined());
+			v8set(value, names::session, Undefined());
+			v8set(value, names::end, False());
+			for (auto field : fields)
+				v8set(value, *field, Undefined());
+			boilerplate(type).Dispose();
+			boilerplate(type) = Persistent<Object>::New(value);
+
+			if (lazilyDelivered(type)) {
+				auto lazy = ObjectTemplate::New();
+				lazy->SetInternalFieldCount(1);
+				for (auto field : { &names::message, &names::request, &names::session, &names::end })
+					lazy->SetAccessor(*field, get, 0, External::Wrap((void*)field));
+				for (auto field : fields)
+					lazy->SetAccessor(*field, get, 0, External::Wrap((void*)field));
+				lazy->Set(names::detach, FunctionTemplate::New(detach));
+				lazyTemplate(type).Dispose();
+				lazyTemplate(type) = Persistent<ObjectTemplate>::New(lazy);
+			}
+		}
+
+		static Handle<Value> get(Local<String> property, const AccessorInfo& info) {
+			auto message = (Message*)info.Holder()->GetPointerFromInternalField(0);
+			if (!message)
+				return Undefined();
+			return message->field(*(const Name*)External::Unwrap(info.Data()));
+		}
+
+		static Handle<Value> detach(const Arguments& args) {
+			auto message = release(args.Holder());
+			if (!message)
+				return Undefined();
+			return message->value();
+		}
+
+		static inline Handle<Value> get(const ATTIME& time) {
+			return v8number(convert(time));
+		}
+
+		static inline Handle<Value> get(const ATPRICE& price) {
+			return v8number(convert(price));
+		}
+
+		static inline Handle<Value> get(ATExchangeType exchange) {
+			return exchanges()[exchange];
+		}
+
+		// the symbol's string, made just once
+		static inline Handle<Value> symbol(uint32_t symbolId) {
+			return symbolTable.string(symbolId);
+		}
+
+		static uint64_t keyOf(Type type, uint32_t symbolId) {
+			return (uint64_t)type << 32 | symbolId;
+		}
+
+		static Strings<Type>& types() {
+			static Strings<Type> strings;
+			return strings;
+		}
+
+		static Strings<ATExchangeType>& exchanges() {
+			static Strings<ATExchangeType> strings;
+			return strings;
+		}
+
+		static Strings<ATTradeConditionType>& tradeConditions() {
+			static Strings<ATTradeConditionType> strings;
+			return strings;
+		}
+
+		static Strings<ATQuoteConditionType>& quoteConditions() {
+			static Strings<ATQuoteConditionType> strings;
+			return strings;
+		}
+
+		static Strings<ATSymbolStatus>& symbolStatuses() {
+			static Strings<ATSymbolStatus> strings;
+			return strings;
+		}
+
+		static Strings<ATStreamResponseType>& streamResponses() {
+			static Strings<ATStreamResponseType> strings;
+			return strings;
+		}
 
-		static inline bool set(Handle<Object> value, const char* name, Type type) {
-			return v8set(value, name, convert(type));
+		static inline bool set(Handle<Object> value, Handle<String> name, Type type) {
+			return v8set(value, name, types()[type]);
 		}
 
-		static inline bool set(Handle<Object> value, const char* name, const ATTIME& time) {
+		static inline bool set(Handle<Object> value, Handle<String> name, const ATTIME& time) {
 			return v8set(value, name, convert(time));
 		}
 
-		static inline bool set(Handle<Object> value, const char* name, const ATPRICE& price) {
+		static inline bool set(Handle<Object> value, Handle<String> name, const ATPRICE& price) {
 			return v8set(value, name, convert(price));
 		}
 
-		static inline bool set(Handle<Object> value, const char* name, ATExchangeType exchange) {
-			return v8set(value, name, convert(exchange));
+		static inline bool set(Handle<Object> value, Handle<String> name, ATExchangeType exchange) {
+			return v8set(value, name, exchanges()[exchange]);
+		}
+
+		static inline bool set(Handle<Object> value, Handle<String> name, ATSymbolStatus symbolStatus) {
+			return v8set(value, name, symbolStatuses()[symbolStatus]);
 		}
 
-		static inline bool set(Handle<Object> value, const char* name, ATSymbolStatus symbolStatus) {
-			return v8set(value, name, convert(symbolStatus));
+		// with booleanFlags, conditions and trade flags are gathered into one object, made only once there is something to put in it
+		static inline bool flag(Handle<Object>& flags, Handle<String> name) {
+			if (name.IsEmpty())
+				return false;
+			if (flags.IsEmpty())
+				flags = Object::New();
+			return v8flag(flags, name);
 		}
 
-		static inline bool flag(Handle<Object> value, ATTradeConditionType condition) {
-			return v8flag(value, convert(condition));
+		static inline bool flag(Handle<Object>& flags, ATTradeConditionType condition) {
+			return flag(flags, tradeConditions()[condition]);
 		}
 
-		static inline bool flag(Handle<Object> value, ATQuoteConditionType condition) {
-			return v8flag(value, convert(condition));
+		static inline bool flag(Handle<Object>& flags, ATQuoteConditionType condition) {
+			return flag(flags, quoteConditions()[condition]);
 		}
 
-		static void flags(Handle<Object> value, ATTradeMessageFlags flags) {
-			if (flags & TradeMessageFlagRegularMarketLastPrice)
-				v8flag(value, "regularMarketLastPrice");
-			if (flags & TradeMessageFlagRegularMarketVolume)
-				v8flag(value, "regularMarketVolume");
-			if (flags & TradeMessageFlagHighPrice)
-				v8flag(value, "highPrice");
-			if (flags & TradeMessageFlagLowPrice)
-				v8flag(value, "lowPrice");
-			if (flags & TradeMessageFlagDayHighPrice)
-				v8flag(value, "dayHighPrice");
-			if (flags & TradeMessageFlagDayLowPrice)
-				v8flag(value, "dayLowPrice");
-			if (flags & TradeMessageFlagExtendedMarketLastPrice)
-				v8flag(value, "extendedMarketLastPrice");
-			if (flags & TradeMessageFlagPreMarketVolume)
-				v8flag(value, "preMarketVolume");
-			if (flags & TradeMessageFlagAfterMarketVolume)
-				v8flag(value, "afterMarketVolume");
-			if (flags & TradeMessageFlagPreMarketOpenPrice)
-				v8flag(value, "preMarketOpenPrice");
-			if (flags & TradeMessageFlagOpenPrice)
-				v8flag(value, "openPrice");
+		// Bit n for condition code n. Code 0 is the regular condition, which is no condition at all, and gets no bit;
+		// every code the API names, up to the last and highest of each, must fit below bit 53, or it would be lost from the mask.
+		static_assert(TradeConditionYellowFlag < 53 && QuoteConditionAutomatedBidNoOfferNoBid < 53,
+			"condition codes must fit in a number's 53 bits");
+
+		template<typename C> static inline uint64_t bit(C condition) {
+			return condition > 0 && condition < 53 ? 1ull << condition : 0;
 		}
 
-		static void set(Handle<Object> value, const char* name, ATSymbolType symbolType, ATExchangeType exchangeType, ATCountryType countryType) {
+		Handle<Value> flagsValue(uint32_t flags) const {
+			if (!booleanFlags())
+				return v8number(flags);
+			auto booleans = this->booleans();
+			if (booleans.IsEmpty())
+				return Null();
+			return booleans;
+		}
+
+		Handle<Object> booleans() const;
+
+		static void flags(Handle<Object>& value, ATTradeMessageFlags flags) {
+			for (uint32_t bit = 1; bit && bit <= (uint32_t)flags; bit <<= 1)
+				if (flags & bit)
+					if (auto name = convert((ATTradeMessageFlags)bit))
+						flag(value, *name);
+		}
+
+		static void set(Handle<Object> value, Handle<String> name, ATSymbolType symbolType, ATExchangeType exchangeType, ATCountryType countryType) {
 			char type[4];
 			type[0] = symbolType;
 			type[1] = exchangeType;
@@ -130,8 +500,8 @@ namespace ActiveTickServerAPI_node {
 			v8set(value, name, type);
 		}
 
-		static inline bool set(Handle<Object> value, const char* name, ATStreamResponseType responseType) {
-			return v8set(value, name, convert(responseType));
+		static inline bool set(Handle<Object> value, Handle<String> name, ATStreamResponseType responseType) {
+			return v8set(value, name, streamResponses()[responseType]);
 		}
 
 	private:
@@ -183,25 +553,6 @@ namespace ActiveTickServerAPI_node {
 			return "unknown";
 		}
 
-		static double convert(const ATTIME& time) {
-			tm t{
-				time.second,
-				time.minute,
-				time.hour,
-				time.day,
-				time.month - 1,
-				time.year - 1900,
-				time.dayOfWeek, 
-				0, -1
-			};
-			auto seconds = mktime(&t);
-			return (double)seconds * 1000.0 + time.milliseconds;
-		}
-
-		static double convert(const ATPRICE& price) {
-			return price.price;
-		}
-
 		static const char* convert(ATExchangeType exchange/*, ATSymbolType symbolType, ATCountryType country*/) {
 			switch (exchange) {
 				case ExchangeAMEX:
@@ -430,6 +781,34 @@ namespace ActiveTickServerAPI_node {
 			return NULL;
 		}
 
+		static const Name* convert(ATTradeMessageFlags flag) {
+			switch (flag) {
+				case TradeMessageFlagRegularMarketLastPrice:
+					return &names::regularMarketLastPrice;
+				case TradeMessageFlagRegularMarketVolume:
+					return &names::regularMarketVolume;
+				case TradeMessageFlagHighPrice:
+					return &names::highPrice;
+				case TradeMessageFlagLowPrice:
+					return &names::lowPrice;
+				case TradeMessageFlagDayHighPrice:
+					return &names::dayHighPrice;
+				case TradeMessageFlagDayLowPrice:
+					return &names::dayLowPrice;
+				case TradeMessageFlagExtendedMarketLastPrice:
+					return &names::extendedMarketLastPrice;
+				case TradeMessageFlagPreMarketVolume:
+					return &names::preMarketVolume;
+				case TradeMessageFlagAfterMarketVolume:
+					return &names::afterMarketVolume;
+				case TradeMessageFlagPreMarketOpenPrice:
+					return &names::preMarketOpenPrice;
+				case TradeMessageFlagOpenPrice:
+					return &names::openPrice;
+			}
+			return NULL;
+		}
+
 		static const char* convert(ATSymbolStatus symbolStatus) {
 			switch (symbolStatus) {
 				case SymbolStatusSuccess:
@@ -466,7 +845,11 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			v8set(value, "error", error);
+			v8set(value, names::error, error);
+		}
+
+		static void shape() {
+			define(Error, { &names::error });
 		}
 	};
 
@@ -481,8 +864,12 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "success", success);
-			v8set(value, "records", records);
+			set(value, names::success, success);
+			v8set(value, names::records, records);
+		}
+
+		static void shape() {
+			define(Success, { &names::success, &names::records });
 		}
 	};
 
@@ -495,7 +882,16 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			v8set(value, "sessionStatus", convert(statusType));
+			v8set(value, names::sessionStatus, statuses()[statusType]);
+		}
+
+		static void shape() {
+			define(SessionStatusChange, { &names::sessionStatus });
+		}
+
+		static Strings<ATSessionStatusType>& statuses() {
+			static Strings<ATSessionStatusType> strings;
+			return strings;
 		}
 
 		static const char* convert(ATSessionStatusType status) {
@@ -526,9 +922,18 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			v8set(value, "loginResponse", convert(response.loginResponse));
+			v8set(value, names::loginResponse, responses()[response.loginResponse]);
 			//v8set(value, "permissions", permissions());
-			set(value, "serverTime", response.serverTime);
+			set(value, names::serverTime, response.serverTime);
+		}
+
+		static void shape() {
+			define(LoginResponse, { &names::loginResponse, &names::serverTime });
+		}
+
+		static Strings<ATLoginResponseType>& responses() {
+			static Strings<ATLoginResponseType> strings;
+			return strings;
 		}
 
 		static const char* convert(ATLoginResponseType response) {
@@ -551,11 +956,13 @@ namespace ActiveTickServerAPI_node {
 	};
 
 	struct StreamResponseMessage : Message {
+		friend struct Message;
+
 		ATStreamResponseType responseType;
 		ATQUOTESTREAM_DATA_ITEM item;
 	private:
 		bool hasItem;
-		const char* successSymbolStatus;
+		const Name* successSymbolStatus;
 		
 	protected:
 		StreamResponseMessage(Type type, uint64_t session, uint64_t request, ATStreamResponseType responseType, bool end) :
@@ -564,7 +971,7 @@ namespace ActiveTickServerAPI_node {
 			hasItem(false)
 		{}
 
-		StreamResponseMessage(Type type, uint64_t session, uint64_t request, ATStreamResponseType responseType, ATQUOTESTREAM_DATA_ITEM& item, bool end, const char* successSymbolStatus) :
+		StreamResponseMessage(Type type, uint64_t session, uint64_t request, ATStreamResponseType responseType, ATQUOTESTREAM_DATA_ITEM& item, bool end, const Name* successSymbolStatus) :
 			Message(type, session, request, end),
 			responseType(responseType),
 			item(item), hasItem(true),
@@ -572,15 +979,20 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "streamResponse", responseType);
+			set(value, names::streamResponse, responseType);
 			if (hasItem) {
-				v8set(value, "symbol", item.symbol.symbol);
+				v8set(value, names::symbol, item.symbol.symbol);
 				if (item.symbolStatus == SymbolStatusSuccess)
-					v8set(value, "symbolStatus", successSymbolStatus);
+					v8set(value, names::symbolStatus, Handle<String>(*successSymbolStatus));
 				else
-					set(value, "symbolStatus", item.symbolStatus);
+					set(value, names::symbolStatus, item.symbolStatus);
 			}
 		}
+
+	public:
+		static void shape(Type type) {
+			define(type, { &names::streamResponse, &names::symbol, &names::symbolStatus });
+		}
 	};
 
 	struct StreamSubscribeResponseMessage : StreamResponseMessage {
@@ -589,7 +1001,7 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		StreamSubscribeResponseMessage(uint64_t session, uint64_t request, ATStreamResponseType responseType, ATQUOTESTREAM_DATA_ITEM& item, bool end = false) :
-			StreamResponseMessage(StreamSubscribeResponse, session, request, responseType, item, end, "subscribed")
+			StreamResponseMessage(StreamSubscribeResponse, session, request, responseType, item, end, &names::subscribed)
 		{}
 	};
 
@@ -599,88 +1011,297 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		StreamUnsubscribeResponseMessage(uint64_t session, uint64_t request, ATStreamResponseType responseType, ATQUOTESTREAM_DATA_ITEM& item, bool end = false) :
-			StreamResponseMessage(StreamUnsubscribeResponse, session, request, responseType, item, end, "unsubscribed")
+			StreamResponseMessage(StreamUnsubscribeResponse, session, request, responseType, item, end, &names::unsubscribed)
 		{}
 	};
 
+	// Stream trades and quotes, the bulk of the traffic, are normalized as they're queued, down to just what's delivered:
+	// the symbol by number, the time in milliseconds since the epoch, the price as it's to be delivered, and the codes as bytes.
+	// They take a fraction of the room of the API's structs, with their wide symbols and broken-down times.
 	struct StreamUpdateTradeMessage : Message {
-		ATQUOTESTREAM_TRADE_UPDATE trade;
-
-		StreamUpdateTradeMessage(ATQUOTESTREAM_TRADE_UPDATE& trade) :
+		uint32_t symbolId;
+		uint32_t lastSize;
+		double time;
+		Price lastPrice;
+		uint32_t flags;
+		uint8_t lastExchange;
+		uint8_t precision;
+		uint8_t conditions[ATTradeConditionsCount];
+
+		StreamUpdateTradeMessage(const ATQUOTESTREAM_TRADE_UPDATE& trade, uint32_t symbolId) :
 			Message(StreamUpdateTrade),
-			trade(trade)
-		{}
+			symbolId(symbolId),
+			lastSize(trade.lastSize),
+			time(convert(trade.lastDateTime)),
+			flags((uint32_t)trade.flags),
+			lastExchange((uint8_t)trade.lastExchange),
+			precision(precisionOf(trade.lastPrice))
+		{
+			lastPrice = price(trade.lastPrice, precision);
+			for (int i = 0; i < ATTradeConditionsCount; ++i)
+				conditions[i] = (uint8_t)trade.condition[i];
+		}
 
 		void populate(Handle<Object> value) {
-			set(value, "time", trade.lastDateTime);
-			v8set(value, "symbol", trade.symbol.symbol);
-			set(value, "lastPrice", trade.lastPrice);
-			v8set(value, "lastSize", trade.lastSize);
-			set(value, "lastExchange", trade.lastExchange);
+			v8set(value, names::time, time);
+			v8set(value, names::symbol, symbol(symbolId));
+			v8set(value, names::symbolId, symbolId);
+			v8set(value, names::lastPrice, price(lastPrice));
+			v8set(value, names::precision, precisionValue(precision));
+			v8set(value, names::lastSize, lastSize);
+			set(value, names::lastExchange, (ATExchangeType)lastExchange);
+			v8set(value, names::conditions, (double)conditionBits());
+			v8set(value, names::flags, flagsValue(flags));
+		}
+
+		Handle<Value> field(const Name& name) {
+			if (&name == &names::time)
+				return v8number(time);
+			if (&name == &names::symbol)
+				return symbol(symbolId);
+			if (&name == &names::symbolId)
+				return v8number(symbolId);
+			if (&name == &names::lastPrice)
+				return v8number(price(lastPrice));
+			if (&name == &names::precision)
+				return precisionValue(precision);
+			if (&name == &names::lastSize)
+				return v8number(lastSize);
+			if (&name == &names::lastExchange)
+				return get((ATExchangeType)lastExchange);
+			if (&name == &names::conditions)
+				return v8number((double)conditionBits());
+			if (&name == &names::flags)
+				return flagsValue(flags);
+			return header(name);
+		}
+
+		uint64_t conditionBits() const {
+			uint64_t bits = 0;
+			for (int i = 0; i < ATTradeConditionsCount; ++i)
+				bits |= bit(conditions[i]);
+			return bits;
+		}
+
+		Handle<Object> booleans() const {
+			Handle<Object> booleans;
 			for (int i = 0; i < ATTradeConditionsCount; ++i)
-				flag(value, trade.condition[i]);
-			flags(value, trade.flags);
+				flag(booleans, (ATTradeConditionType)conditions[i]);
+			Message::flags(booleans, (ATTradeMessageFlags)flags);
+			return booleans;
+		}
+
+		static void shape() {
+			define(StreamUpdateTrade, { &names::time, &names::symbol, &names::symbolId, &names::lastPrice, &names::precision, &names::lastSize, &names::lastExchange, &names::conditions, &names::flags });
 		}
 	};
 
 	struct StreamUpdateQuoteMessage : Message {
-		ATQUOTESTREAM_QUOTE_UPDATE quote;
-
-		StreamUpdateQuoteMessage(ATQUOTESTREAM_QUOTE_UPDATE& quote) :
+		uint32_t symbolId;
+		uint32_t bidSize;
+		double time;
+		Price bidPrice;
+		Price askPrice;
+		uint32_t askSize;
+		uint8_t bidExchange;
+		uint8_t askExchange;
+		uint8_t condition;
+		uint8_t precision;	// the finer of the bid's and the ask's, so both are exact in fixedPoint
+
+		StreamUpdateQuoteMessage(const ATQUOTESTREAM_QUOTE_UPDATE& quote, uint32_t symbolId) :
 			Message(StreamUpdateQuote),
-			quote(quote)
-		{}
+			symbolId(symbolId),
+			bidSize(quote.bidSize),
+			time(convert(quote.quoteDateTime)),
+			askSize(quote.askSize),
+			bidExchange((uint8_t)quote.bidExchange),
+			askExchange((uint8_t)quote.askExchange),
+			condition((uint8_t)quote.condition)
+		{
+			auto bid = precisionOf(quote.bidPrice), ask = precisionOf(quote.askPrice);
+			precision = bid > ask ? bid : ask;
+			bidPrice = price(quote.bidPrice, precision);
+			askPrice = price(quote.askPrice, precision);
+		}
+
+		uint64_t key() const {
+			return keyOf(type, symbolId);
+		}
 
 		void populate(Handle<Object> value) {
-			set(value, "time", quote.quoteDateTime);
-			v8set(value, "symbol", quote.symbol.symbol);
+			v8set(value, names::time, time);
+			v8set(value, names::symbol, symbol(symbolId));
+			v8set(value, names::symbolId, symbolId);
+
+			v8set(value, names::bidPrice, price(bidPrice));
+			v8set(value, names::bidSize, bidSize);
+			set(value, names::bidExchange, (ATExchangeType)bidExchange);
+
+			v8set(value, names::askPrice, price(askPrice));
+			v8set(value, names::askSize, askSize);
+			set(value, names::askExchange, (ATExchangeType)askExchange);
+			v8set(value, names::precision, precisionValue(precision));
+
+			v8set(value, names::conditions, (double)conditionBits());
+			v8set(value, names::flags, flagsValue(0));
+		}
+
+		Handle<Value> field(const Name& name) {
+			if (&name == &names::time)
+				return v8number(time);
+			if (&name == &names::symbol)
+				return symbol(symbolId);
+			if (&name == &names::symbolId)
+				return v8number(symbolId);
+			if (&name == &names::bidPrice)
+				return v8number(price(bidPrice));
+			if (&name == &names::bidSize)
+				return v8number(bidSize);
+			if (&name == &names::bidExchange)
+				return get((ATExchangeType)bidExchange);
+			if (&name == &names::askPrice)
+				return v8number(price(askPrice));
+			if (&name == &names::precision)
+				return precisionValue(precision);
+			if (&name == &names::askSize)
+				return v8number(askSize);
+			if (&name == &names::askExchange)
+				return get((ATExchangeType)askExchange);
+			if (&name == &names::conditions)
+				return v8number((double)conditionBits());
+			if (&name == &names::flags)
+				return flagsValue(0);
+			return header(name);
+		}
 
-			set(value, "bidPrice", quote.bidPrice);
-			v8set(value, "bidSize", quote.bidSize);
-			set(value, "bidExchange", quote.bidExchange);
+		uint64_t conditionBits() const {
+			return bit(condition);
+		}
 
-			set(value, "askPrice", quote.askPrice);
-			v8set(value, "askSize", quote.askSize);
-			set(value, "askExchange", quote.askExchange);
+		Handle<Object> booleans() const {
+			Handle<Object> booleans;
+			flag(booleans, (ATQuoteConditionType)condition);
+			return booleans;
+		}
 
-			flag(value, quote.condition);
+		static void shape() {
+			define(StreamUpdateQuote, { &names::time, &names::symbol, &names::symbolId, &names::bidPrice, &names::bidSize, &names::bidExchange, &names::askPrice, &names::askSize, &names::askExchange, &names::precision, &names::conditions, &names::flags });
 		}
 	};
 
 	struct StreamUpdateRefreshMessage : Message {
 		ATQUOTESTREAM_REFRESH_UPDATE refresh;
+		uint32_t symbolId;
 
-		StreamUpdateRefreshMessage(ATQUOTESTREAM_REFRESH_UPDATE& refresh) :
+		StreamUpdateRefreshMessage(ATQUOTESTREAM_REFRESH_UPDATE& refresh, uint32_t symbolId) :
 			Message(StreamUpdateRefresh),
-			refresh(refresh)
+			refresh(refresh),
+			symbolId(symbolId)
 		{}
 
+		uint64_t key() const {
+			return keyOf(type, symbolId);
+		}
+
 		void populate(Handle<Object> value) {
-			v8set(value, "symbol", refresh.symbol.symbol);
-
-			v8set(value, "volume", (double)refresh.volume);
-			set(value, "openPrice", refresh.openPrice);
-			set(value, "highPrice", refresh.highPrice);
-			set(value, "lowPrice", refresh.lowPrice);
-			set(value, "closePrice", refresh.closePrice);
-			set(value, "prevClosePrice", refresh.prevClosePrice);
-			set(value, "afterMarketClosePrice", refresh.afterMarketClosePrice);
-
-			set(value, "lastPrice", refresh.lastPrice);
-			v8set(value, "lastSize", refresh.lastSize);
-			set(value, "lastExchange", refresh.lastExchange);
-			for (int i = 0; i < ATTradeConditionsCount; ++i)
-				flag(value, refresh.lastCondition[i]);
+			v8set(value, names::symbol, symbol(symbolId));
+			v8set(value, names::symbolId, symbolId);
+
+			v8set(value, names::volume, (double)refresh.volume);
+			set(value, names::openPrice, refresh.openPrice);
+			set(value, names::highPrice, refresh.highPrice);
+			set(value, names::lowPrice, refresh.lowPrice);
+			set(value, names::closePrice, refresh.closePrice);
+			set(value, names::prevClosePrice, refresh.prevClosePrice);
+			set(value, names::afterMarketClosePrice, refresh.afterMarketClosePrice);
+
+			set(value, names::lastPrice, refresh.lastPrice);
+			v8set(value, names::lastSize, refresh.lastSize);
+			set(value, names::lastExchange, refresh.lastExchange);
+
+			set(value, names::bidPrice, refresh.bidPrice);
+			v8set(value, names::bidSize, refresh.bidSize);
+			set(value, names::bidExchange, refresh.bidExchange);
+
+			set(value, names::askPrice, refresh.askPrice);
+			v8set(value, names::askSize, refresh.askSize);
+			set(value, names::askExchange, refresh.askExchange);
+
+			v8set(value, names::conditions, (double)conditionBits());
+			v8set(value, names::quoteConditions, (double)bit(refresh.quoteCondition));
+			v8set(value, names::flags, flagsValue(0));
+		}
 
-			set(value, "bidPrice", refresh.bidPrice);
-			v8set(value, "bidSize", refresh.bidSize);
-			set(value, "bidExchange", refresh.bidExchange);
+		Handle<Value> field(const Name& name) {
+			if (&name == &names::symbol)
+				return symbol(symbolId);
+			if (&name == &names::symbolId)
+				return v8number(symbolId);
+			if (&name == &names::volume)
+				return v8number((double)refresh.volume);
+			if (&name == &names::openPrice)
+				return get(refresh.openPrice);
+			if (&name == &names::highPrice)
+				return get(refresh.highPrice);
+			if (&name == &names::lowPrice)
+				return get(refresh.lowPrice);
+			if (&name == &names::closePrice)
+				return get(refresh.closePrice);
+			if (&name == &names::prevClosePrice)
+				return get(refresh.prevClosePrice);
+			if (&name == &names::afterMarketClosePrice)
+				return get(refresh.afterMarketClosePrice);
+			if (&name == &names::lastPrice)
+				return get(refresh.lastPrice);
+			if (&name == &names::lastSize)
+				return v8number(refresh.lastSize);
+			if (&name == &names::lastExchange)
+				return get(refresh.lastExchange);
+			if (&name == &names::bidPrice)
+				return get(refresh.bidPrice);
+			if (&name == &names::bidSize)
+				return v8number(refresh.bidSize);
+			if (&name == &names::bidExchange)
+				return get(refresh.bidExchange);
+			if (&name == &names::askPrice)
+				return get(refresh.askPrice);
+			if (&name == &names::askSize)
+				return v8number(refresh.askSize);
+			if (&name == &names::askExchange)
+				return get(refresh.askExchange);
+			if (&name == &names::conditions)
+				return v8number((double)conditionBits());
+			if (&name == &names::quoteConditions)
+				return v8number((double)bit(refresh.quoteCondition));
+			if (&name == &names::flags)
+				return flagsValue(0);
+			return header(name);
+		}
+
+		uint64_t conditionBits() const {
+			uint64_t bits = 0;
+			for (int i = 0; i < ATTradeConditionsCount; ++i)
+				bits |= bit(refresh.lastCondition[i]);
+			return bits;
+		}
 
-			set(value, "askPrice", refresh.askPrice);
-			v8set(value, "askSize", refresh.askSize);
-			set(value, "askExchange", refresh.askExchange);
+		Handle<Object> booleans() const {
+			Handle<Object> booleans;
+			for (int i = 0; i < ATTradeConditionsCount; ++i)
+				flag(booleans, refresh.lastCondition[i]);
+			flag(booleans, refresh.quoteCondition);
+			return booleans;
+		}
 
-			flag(value, refresh.quoteCondition);
+		static void shape() {
+			define(StreamUpdateRefresh, {
+				&names::symbol, &names::symbolId, &names::volume,
+				&names::openPrice, &names::highPrice, &names::lowPrice, &names::closePrice, &names::prevClosePrice, &names::afterMarketClosePrice,
+				&names::lastPrice, &names::lastSize, &names::lastExchange,
+				&names::bidPrice, &names::bidSize, &names::bidExchange,
+				&names::askPrice, &names::askSize, &names::askExchange,
+				&names::conditions, &names::quoteConditions, &names::flags
+			});
 		}
 	};
 
@@ -693,9 +1314,13 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "exchanges", item.symbolType, item.exchangeType, item.countryType);
-			set(value, "begins", item.beginDateTime);
-			set(value, "ends", item.endDateTime);
+			set(value, names::exchanges, item.symbolType, item.exchangeType, item.countryType);
+			set(value, names::begins, item.beginDateTime);
+			set(value, names::ends, item.endDateTime);
+		}
+
+		static void shape() {
+			define(Holiday, { &names::exchanges, &names::begins, &names::ends });
 		}
 	};
 
@@ -708,7 +1333,11 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "time", time);
+			set(value, names::time, time);
+		}
+
+		static void shape() {
+			define(ServerTimeUpdate, { &names::time });
 		}
 	};
 
@@ -721,12 +1350,26 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "time", trade.lastDateTime);
-			set(value, "lastPrice", trade.lastPrice);
-			v8set(value, "lastSize", trade.lastSize);
-			set(value, "lastExchange", trade.lastExchange);
+			set(value, names::time, trade.lastDateTime);
+			set(value, names::lastPrice, trade.lastPrice);
+			v8set(value, names::lastSize, trade.lastSize);
+			set(value, names::lastExchange, trade.lastExchange);
+			uint64_t conditions = 0;
+			for (int i = 0; i < ATTradeConditionsCount; ++i)
+				conditions |= bit(trade.lastCondition[i]);
+			v8set(value, names::conditions, (double)conditions);
+			v8set(value, names::flags, flagsValue(0));
+		}
+
+		Handle<Object> booleans() const {
+			Handle<Object> booleans;
 			for (int i = 0; i < ATTradeConditionsCount; ++i)
-				flag(value, trade.lastCondition[i]);
+				flag(booleans, trade.lastCondition[i]);
+			return booleans;
+		}
+
+		static void shape() {
+			define(TickHistoryTrade, { &names::time, &names::lastPrice, &names::lastSize, &names::lastExchange, &names::conditions, &names::flags });
 		}
 	};
 
@@ -739,17 +1382,28 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "time", quote.quoteDateTime);
+			set(value, names::time, quote.quoteDateTime);
 
-			set(value, "bidPrice", quote.bidPrice);
-			v8set(value, "bidSize", quote.bidSize);
-			set(value, "bidExchange", quote.bidExchange);
+			set(value, names::bidPrice, quote.bidPrice);
+			v8set(value, names::bidSize, quote.bidSize);
+			set(value, names::bidExchange, quote.bidExchange);
+
+			set(value, names::askPrice, quote.askPrice);
+			v8set(value, names::askSize, quote.askSize);
+			set(value, names::askExchange, quote.askExchange);
+
+			v8set(value, names::conditions, (double)bit(quote.quoteCondition));
+			v8set(value, names::flags, flagsValue(0));
+		}
 
-			set(value, "askPrice", quote.askPrice);
-			v8set(value, "askSize", quote.askSize);
-			set(value, "askExchange", quote.askExchange);
+		Handle<Object> booleans() const {
+			Handle<Object> booleans;
+			flag(booleans, quote.quoteCondition);
+			return booleans;
+		}
 
-			flag(value, quote.quoteCondition);
+		static void shape() {
+			define(TickHistoryQuote, { &names::time, &names::bidPrice, &names::bidSize, &names::bidExchange, &names::askPrice, &names::askSize, &names::askExchange, &names::conditions, &names::flags });
 		}
 	};
 
@@ -764,10 +1418,19 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			v8set(value, "barHistoryResponse", convert(responseType));
-			v8set(value, "symbol", response.symbol.symbol);
-			set(value, "symbolStatus", response.status);
-			v8set(value, "records", response.recordCount);
+			v8set(value, names::barHistoryResponse, responses()[responseType]);
+			v8set(value, names::symbol, response.symbol.symbol);
+			set(value, names::symbolStatus, response.status);
+			v8set(value, names::records, response.recordCount);
+		}
+
+		static void shape() {
+			define(BarHistoryResponse, { &names::barHistoryResponse, &names::symbol, &names::symbolStatus, &names::records });
+		}
+
+		static Strings<ATBarHistoryResponseType>& responses() {
+			static Strings<ATBarHistoryResponseType> strings;
+			return strings;
 		}
 
 		static const char* convert(ATBarHistoryResponseType response) {
@@ -794,12 +1457,138 @@ namespace ActiveTickServerAPI_node {
 		{}
 
 		void populate(Handle<Object> value) {
-			set(value, "time", record.barTime);
-			set(value, "open", record.open);
-			set(value, "high", record.high);
-			set(value, "low", record.low);
-			set(value, "close", record.close);
-			v8set(value, "volume", (double)record.volume);
+			set(value, names::time, record.barTime);
+			set(value, names::open, record.open);
+			set(value, names::high, record.high);
+			set(value, names::low, record.low);
+			set(value, names::close, record.close);
+			v8set(value, names::volume, (double)record.volume);
+		}
+
+		static void shape() {
+			define(BarHistory, { &names::time, &names::open, &names::high, &names::low, &names::close, &names::volume });
 		}
 	};
-}
\ No newline at end of file
+
+	inline void Message::intern() {
+		Name::intern();
+		types().intern(convert);
+		exchanges().intern(convert);
+		tradeConditions().intern(convert);
+		quoteConditions().intern(convert);
+		symbolStatuses().intern(convert);
+		streamResponses().intern(convert);
+		SessionStatusChangeMessage::statuses().intern(SessionStatusChangeMessage::convert);
+		LoginResponseMessage::responses().intern(LoginResponseMessage::convert);
+		BarHistoryResponseMessage::responses().intern(BarHistoryResponseMessage::convert);
+
+		for (int type = None; type < TypeCount; ++type)
+			define((Type)type, {});
+		ErrorMessage::shape();
+		SuccessMessage::shape();
+		SessionStatusChangeMessage::shape();
+		LoginResponseMessage::shape();
+		StreamResponseMessage::shape(StreamSubscribeResponse);
+		StreamResponseMessage::shape(StreamUnsubscribeResponse);
+		StreamUpdateTradeMessage::shape();
+		StreamUpdateQuoteMessage::shape();
+		StreamUpdateRefreshMessage::shape();
+		HolidayMessage::shape();
+		ServerTimeUpdateMessage::shape();
+		TickHistoryTradeMessage::shape();
+		TickHistoryQuoteMessage::shape();
+		BarHistoryResponseMessage::shape();
+		BarHistoryMessage::shape();
+	}
+
+	inline void Message::populate(Handle<Object> value) {
+		switch (type) {
+			case Error:
+				return ((ErrorMessage*)this)->populate(value);
+			case Success:
+				return ((SuccessMessage*)this)->populate(value);
+			case SessionStatusChange:
+				return ((SessionStatusChangeMessage*)this)->populate(value);
+			case LoginResponse:
+				return ((LoginResponseMessage*)this)->populate(value);
+			case StreamSubscribeResponse:
+			case StreamUnsubscribeResponse:
+				return ((StreamResponseMessage*)this)->populate(value);
+			case StreamUpdateTrade:
+				return ((StreamUpdateTradeMessage*)this)->populate(value);
+			case StreamUpdateQuote:
+				return ((StreamUpdateQuoteMessage*)this)->populate(value);
+			case StreamUpdateRefresh:
+				return ((StreamUpdateRefreshMessage*)this)->populate(value);
+			case Holiday:
+				return ((HolidayMessage*)this)->populate(value);
+			case ServerTimeUpdate:
+				return ((ServerTimeUpdateMessage*)this)->populate(value);
+			case TickHistoryTrade:
+				return ((TickHistoryTradeMessage*)this)->populate(value);
+			case TickHistoryQuote:
+				return ((TickHistoryQuoteMessage*)this)->populate(value);
+			case BarHistoryResponse:
+				return ((BarHistoryResponseMessage*)this)->populate(value);
+			case BarHistory:
+				return ((BarHistoryMessage*)this)->populate(value);
+		}
+	}
+
+	inline Handle<Value> Message::field(const Name& name) {
+		switch (type) {
+			case StreamUpdateTrade:
+				return ((StreamUpdateTradeMessage*)this)->field(name);
+			case StreamUpdateQuote:
+				return ((StreamUpdateQuoteMessage*)this)->field(name);
+			case StreamUpdateRefresh:
+				return ((StreamUpdateRefreshMessage*)this)->field(name);
+		}
+		return header(name);
+	}
+
+	inline uint64_t Message::key() const {
+		switch (type) {
+			case StreamUpdateQuote:
+				return ((const StreamUpdateQuoteMessage*)this)->key();
+			case StreamUpdateRefresh:
+				return ((const StreamUpdateRefreshMessage*)this)->key();
+		}
+		return 0;
+	}
+
+	inline Handle<Object> Message::booleans() const {
+		switch (type) {
+			case StreamUpdateTrade:
+				return ((const StreamUpdateTradeMessage*)this)->booleans();
+			case StreamUpdateQuote:
+				return ((const StreamUpdateQuoteMessage*)this)->booleans();
+			case StreamUpdateRefresh:
+				return ((const StreamUpdateRefreshMessage*)this)->booleans();
+			case TickHistoryTrade:
+				return ((const TickHistoryTradeMessage*)this)->booleans();
+			case TickHistoryQuote:
+				return ((const TickHistoryQuoteMessage*)this)->booleans();
+		}
+		return Handle<Object>();
+	}
+
+	static_assert(std::is_trivially_destructible<StreamUpdateTradeMessage>::value && std::is_trivially_destructible<StreamUpdateQuoteMessage>::value
+		&& std::is_trivially_destructible<StreamResponseMessage>::value && std::is_trivially_destructible<BarHistoryMessage>::value,
+		"messages are released without being destroyed");
+	static_assert(sizeof(StreamUpdateTradeMessage) <= 64 && sizeof(StreamUpdateQuoteMessage) <= 64, "stream updates are a cache line apiece");
+
+	inline void Message::tables(Handle<Object> exports) {
+		v8set(exports, "exchanges", exchanges().array());
+		v8set(exports, "tradeConditions", tradeConditions().array());
+		v8set(exports, "quoteConditions", quoteConditions().array());
+
+		auto tradeFlags = Array::New();
+		uint32_t n = 0;
+		for (uint32_t bit = 1; bit; bit <<= 1, ++n)
+			if (auto name = convert((ATTradeMessageFlags)bit))
+				tradeFlags->Set(n, Handle<String>(*name));
+		v8set(exports, "tradeFlags", tradeFlags);
+	}
+
+}
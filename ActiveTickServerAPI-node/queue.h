@@ -1,10 +1,21 @@
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
 #include <thread>
 
 #define roundup(value, pow2) ((value + pow2 - 1) & ~(pow2 - 1))
 #define mod(value, pow2) ((value) & ((pow2) - 1))
 #define isPowerOf2(x) (((x) & ((x)-1)) == 0)
+#ifdef _MSC_VER
+#define threadlocal __declspec(thread)
+#else
+#define threadlocal thread_local
+#endif
 
 namespace ActiveTickServerAPI_node {
 
@@ -12,54 +23,131 @@ namespace ActiveTickServerAPI_node {
 		Queue(const Queue&) = delete;
 		Queue& operator=(const Queue&) = delete;
 
+	public:
+		// What a producer does when its lane is full
+		enum Overflow {
+			Throw,		// retry for a while, then throw queue_overflow
+			Block,		// wait for the consumer to free some space, however long that takes
+			DropNewest,	// discard the message being pushed
+			DropOldest,	// discard the oldest messages not yet popped
+			Conflate,	// keep only the latest message of each key until there is room
+		};
+
+	private:
+
+		// The top two bits are flags, the next six say which lane the entry was claimed in, and the rest are its size
 		class Indicator {
 			size_t _value;
 
-			static const size_t Mask = SIZE_MAX >> 2;
-			static const size_t Committed = 0x2 << (sizeof(size_t) * 8 - 2);
-			static const size_t Failed = 0x3 << (sizeof(size_t) * 8 - 2);
+			static const size_t Flags = ~(SIZE_MAX >> 2);
+			static const size_t LaneShift = sizeof(size_t) * 8 - 8;
+			static const size_t Mask = SIZE_MAX >> 8;
+			static const size_t Released = (size_t)0x1 << (sizeof(size_t) * 8 - 2);
+			static const size_t Committed = (size_t)0x2 << (sizeof(size_t) * 8 - 2);
+			static const size_t Failed = (size_t)0x3 << (sizeof(size_t) * 8 - 2);
 
 		public:
+			static const size_t MaxSize = Mask;
+			static const size_t MaxLanes = 64;
+
 			inline Indicator() {}
-			inline explicit Indicator(size_t size) : _value(size) {}
+			inline explicit Indicator(size_t size, size_t lane = 0) : _value(size | lane << LaneShift) {}
 
 			inline size_t size() const {
 				return _value & Mask;
 			}
 
+			inline size_t lane() const {
+				return (_value >> LaneShift) & (MaxLanes - 1);
+			}
+
 			inline bool free() const {
-				return (_value & ~Mask) == 0;
+				return (_value & Flags) == 0;
 			}
 
 			inline Indicator commit() const {
-				return Indicator((_value & Mask) | Committed);
+				return flag(Committed);
 			}
 
 			inline bool committed() const {
-				return (_value & ~Mask) == Committed;
+				return (_value & Flags) == Committed;
 			}
 
 			inline Indicator fail() const {
-				return Indicator((_value & Mask) | Failed);
+				return flag(Failed);
 			}
 
 			inline bool failed() const {
-				return (_value & ~Mask) == Failed;
+				return (_value & Flags) == Failed;
+			}
+
+			// once released, the size may cover a whole run of entries
+			inline Indicator release() const {
+				return flag(Released);
+			}
+
+		private:
+			inline Indicator flag(size_t flags) const {
+				Indicator indicator;
+				indicator._value = (_value & ~Flags) | flags;
+				return indicator;
+			}
+		};
+
+		// A Stamp sits in each entry's header, and records the position the entry was claimed at.
+		// The consumer compares it with its own position, so stale entries from earlier laps
+		// never look ready, and nothing needs clearing when an entry is released.
+		// Once released, it says so, for the trailing cursor to sweep past.
+		// Where an earlier lap left payload instead of a header, a stale word could only pass for a stamp by holding
+		// this lap's position with the top bit set: as a double, a negative denormal, and as an integer, one below -2^62,
+		// neither of which any message holds.
+		class Stamp {
+			std::atomic<size_t> _value;
+
+		public:
+			// positions never use the top two bits
+			static const size_t Published = (size_t)0x1 << (sizeof(size_t) * 8 - 1);
+			static const size_t Released = (size_t)0x1 << (sizeof(size_t) * 8 - 2);
+
+			inline void claim(size_t position) {
+				_value.store(position, std::memory_order_relaxed);
+			}
+
+			// for entries the consumer can't reach until an earlier one is published
+			inline void claim(size_t position, bool published) {
+				_value.store(published ? position | Published : position, std::memory_order_relaxed);
+			}
+
+			inline void publish() {
+				_value.store(_value.load(std::memory_order_relaxed) | Published, std::memory_order_release);
+			}
+
+			inline bool published(size_t position) const {
+				return _value.load(std::memory_order_acquire) == (position | Published);
+			}
+
+			inline size_t position() const {
+				return _value.load(std::memory_order_relaxed) & ~(Published | Released);
+			}
+
+			inline void release(size_t position) {
+				_value.store(position | Released, std::memory_order_release);
+			}
+
+			inline bool released(size_t position) const {
+				return _value.load(std::memory_order_acquire) == (position | Released);
 			}
 		};
 
 		class Header {
 			std::atomic<Indicator> _value;
+			Stamp _stamp;
 
 		public:
 			static inline Header* At(const void* p, size_t offset) {
 				return (Header*)((const char*)p + offset);
 			}
 
-			inline Header* preceding() const {
-				return (Header*)((const char*)this - BlockSize);
-			}
-
 			inline void* payload() const {
 				return (void*)((const char*)this + HeaderSize);
 			}
@@ -76,55 +164,77 @@ namespace ActiveTickServerAPI_node {
 				return _value.load(std::memory_order_relaxed);
 			}
 
-			inline void release(Indicator value) {
-				_value.store(value, std::memory_order_release);
+			inline Stamp& stamp() {
+				return _stamp;
 			}
 
-			inline Indicator acquire() const {
-				return _value.load(std::memory_order_acquire);
+			inline size_t position() const {
+				return _stamp.position();
+			}
+
+			// the consumer may have it once the stamp is published
+			inline void publish(Indicator value) {
+				set(value);
+				_stamp.publish();
 			}
 		};
 
+		// Places count positions, which run on past the end of the buffer and wrap around to it,
+		// so that each lap of the buffer is told apart from the last
 		class Place {
 			Place(const Place&) = delete;
 			Place& operator=(const Place&) = delete;
 			std::atomic<size_t> _value;
 
 		public:
+			// a sealed Place won't advance any further
+			static const size_t Sealed = (size_t)0x1 << (sizeof(size_t) * 8 - 1);
+
+			// positions never use the top two bits, which a Stamp keeps for its marks
+			static const size_t Mask = SIZE_MAX >> 2;
+
+			static inline size_t after(size_t position, size_t amount) {
+				return (position + amount) & Mask;
+			}
+
 			inline Place() {
 				_value.store(0, std::memory_order_relaxed);
 			}
 
+			inline void seal() {
+				_value.fetch_or(Sealed, std::memory_order_acq_rel);
+			}
+
+			// carries on from the same position
+			inline void unseal() {
+				_value.fetch_and(~Sealed, std::memory_order_acq_rel);
+			}
+
+			inline bool sealed() const {
+				return (_value.load(std::memory_order_acquire) & Sealed) != 0;
+			}
+
+			inline size_t unsealed() const {
+				return _value.load(std::memory_order_acquire) & Mask;
+			}
+
 			inline operator size_t() const {
 				return _value.load(std::memory_order_relaxed);
 			}
 
-			inline bool try_advance(size_t& current, size_t amount, size_t BufferSize) {
-				auto next = mod(current + amount, BufferSize);
-				return _value.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed);
+			inline size_t acquire() const {
+				return _value.load(std::memory_order_acquire);
 			}
 
-			inline void spin_advance(size_t expected, size_t amount, size_t BufferSize) {
-				auto next = mod(expected + amount, BufferSize);
-				size_t current;
-				do {
-					current = expected;
-				} while (!_value.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+			inline bool try_advance(size_t& current, size_t amount) {
+				return _value.compare_exchange_weak(current, after(current, amount), std::memory_order_acq_rel, std::memory_order_relaxed);
 			}
-		};
 
-		static void zero(void* p, size_t outersize) {
-			auto header = Header::At(p, outersize);
-			while (header > p) {
-				header = header->preceding();
-				header->set(Indicator(0));
+			inline void advance(size_t current, size_t amount) {
+				_value.store(after(current, amount), std::memory_order_release);
 			}
-		}
 
-		void _release(Header* header, size_t size) {
-			zero(header, size);
-			_trailing.spin_advance(placeOf(header), size, BufferSize);
-		}
+		};
 
 		// Header is an allocation's preamble
 		// We round up the size for memory alignment
@@ -133,132 +243,1454 @@ namespace ActiveTickServerAPI_node {
 		// Blocks are the granularity of allocation.  
 		// Needs to be a power-of-2, so a whole number of them fit in the buffer
 		static const size_t BlockSize = HeaderSize;
-		
-		size_t BufferSize;
-		void* _buffer;
-		Place _head;
-		Place _tail;
-		Place _trailing;
 
-		inline Header* headerAt(size_t offset) {
-			return Header::At(_buffer, offset);
+		// Cursors that are written by different threads are kept this far apart, so they don't share a cache line
+		static const size_t CacheLine = 64;
+
+		// A Tally keeps a lane's counts, so producers on their own lanes don't contend for them.
+		// They are only ever read for statistics, so they need no ordering.
+		struct Tally {
+			std::atomic<size_t> claims;		// calls to claim space
+			std::atomic<size_t> collisions;	// claims that lost a race with another producer, and tried again
+			std::atomic<size_t> wraps;		// claims that skipped the end of a buffer
+			std::atomic<size_t> claimed;	// bytes claimed, including what was skipped
+			char _pad[CacheLine - sizeof(size_t)];
+			std::atomic<size_t> released;	// bytes released, by the consumer
+
+			Tally() {
+				claims.store(0, std::memory_order_relaxed);
+				collisions.store(0, std::memory_order_relaxed);
+				wraps.store(0, std::memory_order_relaxed);
+				claimed.store(0, std::memory_order_relaxed);
+				released.store(0, std::memory_order_relaxed);
+			}
+
+			static inline void count(std::atomic<size_t>& counter, size_t amount = 1) {
+				counter.fetch_add(amount, std::memory_order_relaxed);
+			}
+		};
+
+		// A Segment is one ring buffer, in memory or spilled to a file.
+		// Once sealed, it takes no more claims, and is done with when it has been drained and released.
+		class Segment {
+			Segment(const Segment&) = delete;
+			Segment& operator=(const Segment&) = delete;
+
+			size_t BufferSize;
+			void* _buffer;
+			SpillFile* _file;
+			Queue* _queue;
+			Tally* _tally;
+			bool _shared;
+			char _pad0[CacheLine];
+			Place _head;	// producers'
+			char _pad1[CacheLine - sizeof(Place)];
+			Place _tail;	// the consumer's
+			char _pad2[CacheLine - sizeof(Place)];
+			Place _trailing;	// the consumer's, and evicting producers'
+			char _pad3[CacheLine - sizeof(Place)];
+			std::atomic<Segment*> _next;
+
+			inline Header* headerAt(size_t position) {
+				return Header::At(_buffer, mod(position, BufferSize));
+			}
+
+			inline Stamp* stampAt(size_t position) {
+				return &headerAt(position)->stamp();
+			}
+
+			// a newly claimed header, not yet published
+			inline Header* claimAt(size_t position) {
+				auto header = headerAt(position);
+				header->stamp().claim(position);
+				return header;
+			}
+
+			inline size_t bytesBetween(size_t start, size_t end) {
+				auto bytes = BufferSize - ((start - end) & Place::Mask);
+				return bytes;
+			}
+
+			inline size_t bytesToEnd(size_t position) {
+				return BufferSize - mod(position, BufferSize);
+			}
+
+			// Entries may be released in any order.  Each is marked released where it stands,
+			// and whoever releases the one the trailing cursor is waiting at carries it on
+			// over every released entry after it, so no one ever waits for anyone else.
+			void _release(Header* header, size_t size) {
+				Tally::count(_tally->released, size);
+				if (_file)
+					_queue->_drained += size;
+				auto& stamp = header->stamp();
+				auto position = stamp.position();
+				header->set(Indicator(size).release());
+				stamp.release(position);
+				sweep();
+			}
+
+			void sweep() {
+				for (;;) {
+					// pairs with the fence of anyone else releasing or sweeping, so that if we miss their mark,
+					// they see that we've moved the cursor up to it
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					size_t trailing = _trailing;
+					if (!stampAt(trailing)->released(trailing))
+						return;
+					// if someone else got there first, we start again from wherever they left it
+					_trailing.try_advance(trailing, headerAt(trailing)->get().size());
+				}
+			}
+
+			inline void claimed(size_t claim) {
+				Tally::count(_tally->claimed, claim);
+				if (_file)
+					_queue->_spilled += claim;
+			}
+
+			// A lane's owner is its only producer, so there is no one to race;
+			// the shared lane's producers race with a CAS, and whoever loses tries again from where the winner left off
+			Header* advance(size_t size) {
+				size_t head = _head, remaining, claim;
+				for (bool retry = false; ; retry = true) {
+					if (head & Place::Sealed)
+						return NULL;
+					if (retry)
+						Tally::count(_tally->collisions);
+
+					// check for wrapping end of buffer
+					remaining = bytesToEnd(head);
+					claim = (size <= remaining) ? size : size + remaining;
+
+					// check for lapping
+					if (claim >= bytesBetween(head, _trailing.acquire()))
+						return NULL;
+
+					if (!_shared) {
+						_head.advance(head, claim);
+						break;
+					}
+					if (_head.try_advance(head, claim))
+						break;
+				}
+
+				claimed(claim);
+
+				// if we wrapped the buffer, then mark the 'remaining' released
+				if (claim > size) {
+					Tally::count(_tally->wraps);
+					claimAt(head)->publish(Indicator(remaining).fail());
+					head = Place::after(head, remaining);
+				}
+
+				return claimAt(head);
+			}
+
+		public:
+			// freshly committed memory is zeroed already
+			Segment(size_t size, const Backing& backing, Tally* tally, bool shared) : BufferSize(size), _file(NULL), _queue(NULL), _tally(tally), _shared(shared) {
+				assert(isPowerOf2(BufferSize));
+				_buffer = backing.allocate(BufferSize);
+				if (!_buffer)
+					throw std::bad_alloc();
+				_next.store(NULL, std::memory_order_relaxed);
+			}
+
+			// a freshly mapped file is zeroed already
+			Segment(size_t size, SpillFile* file, Queue* queue, Tally* tally, bool shared) : BufferSize(size), _buffer(file->view()), _file(file), _queue(queue), _tally(tally), _shared(shared) {
+				assert(isPowerOf2(BufferSize));
+				_next.store(NULL, std::memory_order_relaxed);
+			}
+
+			~Segment() {
+				if (_file)
+					delete _file;
+				else
+					Backing::release(_buffer);
+			}
+
+			inline size_t capacity() const {
+				return BufferSize;
+			}
+
+			inline bool spilled() const {
+				return _file != NULL;
+			}
+
+			// only once drained and released, when the whole buffer is free again.
+			// It stays sealed until it's linked, in case a producer has wandered in from the pool.
+			void reset() {
+				_next.store(NULL, std::memory_order_relaxed);
+			}
+
+			inline Segment* next() const {
+				return _next.load(std::memory_order_acquire);
+			}
+
+			inline void link(Segment* next) {
+				_next.store(next, std::memory_order_release);
+			}
+
+			inline void seal() {
+				_head.seal();
+			}
+
+			inline void unseal() {
+				_head.unseal();
+			}
+
+			inline bool sealed() const {
+				return _head.sealed();
+			}
+
+			// nothing claimed is still waiting to be popped
+			inline bool drained() const {
+				return _tail == _head.unsealed();
+			}
+
+			// nothing popped is still waiting to be released
+			inline bool released() const {
+				return _trailing == _tail;
+			}
+
+			inline bool contains(const void* p) const {
+				return p >= _buffer && p < (const char*)_buffer + BufferSize;
+			}
+
+			inline Header* claim(size_t size) {
+				return advance(size);
+			}
+
+			Header* pop() {
+				for (;;) {
+					Header* header;
+					Indicator indicator;
+
+					// lay claim to the entry pointed to by _tail
+					size_t tail = _tail;
+					do {
+						// if it isn't published for this lap, then there's nothing to pop
+						if (!stampAt(tail)->published(tail))
+							return NULL;
+						header = headerAt(tail);
+						indicator = header->get();
+					} while (!_tail.try_advance(tail, indicator.size()));
+
+					// now we have exclusive write access
+					// although others can read our header
+					if (indicator.committed())
+						return header;
+
+					// skip failed entries
+					_release(header, indicator.size());
+				}
+			}
+
+			void release(Header* header) {
+				// we have exclusive write-access to our memory
+				auto indicator = header->get();
+				_release(header, indicator.size());
+			}
+
+			// lay claim to a run of entries with a single advance of _tail,
+			// up to 'count' committed ones, and no further than the end of the buffer
+			Header* popRun(size_t& count, size_t& bytes) {
+				size_t tail = _tail, committed;
+				do {
+					committed = 0;
+					bytes = 0;
+					auto end = bytesToEnd(tail);
+					while (committed < count && bytes < end) {
+						auto position = Place::after(tail, bytes);
+						if (!stampAt(position)->published(position))
+							break;
+						auto indicator = headerAt(position)->get();
+						bytes += indicator.size();
+						if (indicator.committed())
+							++committed;
+					}
+					if (!bytes)
+						return NULL;
+				} while (!_tail.try_advance(tail, bytes));
+
+				count = committed;
+				return headerAt(tail);
+			}
+
+			// the whole run is let go at once
+			void releaseRun(Header* first, size_t bytes) {
+				_release(first, bytes);
+			}
+		};
+
+		// Each producer thread is identified by the address of its own thread-local record of the lanes it owns.
+		// It gives them up as it exits, for the threads that come after it,
+		// so a queue must outlive the threads producing into it, but for the one that destroys it.
+		// The record also keeps the queues whose shared lane the thread was sent to,
+		// as it must stay there, or a lane it adopted later would let its newer messages overtake its older ones.
+		struct Owner {
+			static const size_t MaxLanes = 16;
+
+			std::atomic<size_t>* lanes[MaxLanes];
+			size_t count;
+			const Queue* sharing[MaxLanes];
+			size_t sharingCount;
+
+			bool shares(const Queue* queue) const {
+				for (size_t i = 0; i < sharingCount; ++i)
+					if (sharing[i] == queue)
+						return true;
+				return false;
+			}
+
+			// past that many queues, the thread may yet adopt a lane
+			void share(const Queue* queue) {
+				if (sharingCount < MaxLanes)
+					sharing[sharingCount++] = queue;
+			}
+
+			void unshare(const Queue* queue) {
+				for (size_t i = 0; i < sharingCount; ++i) {
+					if (sharing[i] == queue) {
+						sharing[i] = sharing[--sharingCount];
+						return;
+					}
+				}
+			}
+
+			inline size_t id() const {
+				return (size_t)this;
+			}
+
+			void adopted(std::atomic<size_t>* owner) {
+				if (count == 0)
+					watch(this);
+				// any more than that stay owned
+				if (count < MaxLanes)
+					lanes[count++] = owner;
+			}
+
+			void forget(const std::atomic<size_t>* owner) {
+				for (size_t i = 0; i < count; ++i) {
+					if (lanes[i] == owner) {
+						lanes[i] = lanes[--count];
+						return;
+					}
+				}
+			}
+
+			// whatever was claimed before is handed over with the lane
+			void exit() {
+				for (size_t i = 0; i < count; ++i) {
+					size_t id = this->id();
+					lanes[i]->compare_exchange_strong(id, 0, std::memory_order_release, std::memory_order_relaxed);
+				}
+				count = 0;
+			}
+		};
+
+#ifdef _MSC_VER
+		// a thread-local can't have a destructor, but fiber-local storage calls back as each thread exits
+		static void WINAPI exited(void* owner) {
+			((Owner*)owner)->exit();
 		}
 
-		inline size_t placeOf(Header* header) {
-			return (char*)header - (char*)_buffer;
+		static void watch(Owner* owner) {
+			static volatile LONG index = (LONG)FLS_OUT_OF_INDEXES;
+			if (index == (LONG)FLS_OUT_OF_INDEXES) {
+				auto allocated = (LONG)FlsAlloc(exited);
+				if (InterlockedCompareExchange(&index, allocated, (LONG)FLS_OUT_OF_INDEXES) != (LONG)FLS_OUT_OF_INDEXES)
+					FlsFree((DWORD)allocated);
+			}
+			if (index != (LONG)FLS_OUT_OF_INDEXES)
+				FlsSetValue((DWORD)index, owner);
 		}
 
-		inline size_t bytesBetween(size_t start, size_t end) {
-			auto bytes = BufferSize - mod(start - end, BufferSize);
-			return bytes;
+		static Owner& owner() {
+			static threadlocal Owner record;
+			return record;
 		}
+#else
+		struct ExitingOwner : Owner {
+			~ExitingOwner() {
+				exit();
+			}
+		};
+
+		static void watch(Owner*) {}
 
-		inline size_t bytesToEnd(size_t head) {
-			return bytesBetween(head, 0);
+		static Owner& owner() {
+			static threadlocal ExitingOwner record;
+			return record;
 		}
+#endif
+
+		// A Lane is a chain of segments.  Producers claim from the newest, and the consumer pops from the oldest.
+		// The shared lane takes any number of producers, and claims space with a CAS loop.
+		// Other lanes are owned by a single producer thread, and claim without contention.
+		// When the newest segment fills, the lane links another, if the queue's limit allows.
+		// Drained segments go back to a small pool, and beyond that are freed.
+		class Lane {
+			Lane(const Lane&) = delete;
+			Lane& operator=(const Lane&) = delete;
+
+			static const size_t PoolSize = 1;
+
+			Queue* _queue;
+			size_t SegmentSize;
+			size_t _index;
+			bool _shared;
+			std::atomic<size_t> _owner;
+			std::atomic<Segment*> _newest;
+			std::atomic<Segment*> _oldest;
+			std::atomic<size_t> _users;
+			std::mutex _chain;
+			Segment* _pool;
+			size_t _pooled;
+			Tally _tally;
 
-		Header* _claim(size_t size) {
-			size_t head = _head, remaining, claim;
-			do {
-				// check for wrapping end of buffer
-				remaining = bytesToEnd(head);
-				claim = (size <= remaining) ? size : size + remaining;
+			Segment* grow(Segment* full) {
+				std::lock_guard<std::mutex> lock(_chain);
 
-				// check for lapping
-				if (claim >= bytesBetween(head, _trailing))
+				// someone else grew the lane first, and 'full' may even have been retired since
+				auto newest = _newest.load(std::memory_order_relaxed);
+				if (newest != full)
+					return newest;
+
+				Segment* segment;
+				if (_pool) {
+					segment = _pool;
+					_pool = segment->next();
+					--_pooled;
+					segment->reset();
+				}
+				else if (_queue->reserve(SegmentSize))
+					segment = new Segment(SegmentSize, _queue->_backing, &_tally, _shared);
+				else if (!(segment = _queue->spill(SegmentSize, &_tally, _shared)))
 					return NULL;
-			} while (!_head.try_advance(head, claim, BufferSize));
 
-			// if we wrapped the buffer, then mark the 'remaining' released
-			auto header = headerAt(head);
-			if (claim > size) {
-				header->release(Indicator(remaining).fail());
-				header = headerAt(0);
+				// publish it as the newest before linking, so a producer that follows the link
+				// won't go back to 'full' on its next claim;
+				// and link before sealing, so whoever finds it sealed can follow along
+				_newest.store(segment, std::memory_order_seq_cst);
+				full->link(segment);
+				segment->unseal();
+				full->seal();
+				return segment;
+			}
+
+			// Must hold the chain lock.
+			// Whoever enters bumps the users, then reads the newest or oldest segment; we move those on, then read the users.
+			// All four are sequentially consistent, so either we see them in the lane, or they see that we moved on.
+			void retire(Segment* segment) {
+				// give back the disk space as soon as possible
+				if (segment->spilled() && _users.load(std::memory_order_seq_cst) == 0) {
+					_queue->unspill(segment);
+					return;
+				}
+
+				segment->link(_pool);
+				_pool = segment;
+				++_pooled;
+
+				// a producer that is mid-claim may still be looking at a segment it thinks is the newest
+				while (_pooled > PoolSize && _users.load(std::memory_order_seq_cst) == 0) {
+					segment = _pool;
+					_pool = segment->next();
+					--_pooled;
+					dispose(segment);
+				}
+			}
+
+			Segment* segmentOf(const void* p) const {
+				for (auto segment = _oldest.load(std::memory_order_acquire); segment; segment = segment->next())
+					if (segment->contains(p))
+						return segment;
+				return NULL;
+			}
+
+		public:
+			Lane() : _queue(NULL), SegmentSize(0), _index(0), _shared(false), _pool(NULL), _pooled(0) {
+				_owner.store(0, std::memory_order_relaxed);
+				_newest.store(NULL, std::memory_order_relaxed);
+				_oldest.store(NULL, std::memory_order_relaxed);
+				_users.store(0, std::memory_order_relaxed);
+			}
+
+			~Lane() {
+				for (auto segment = _oldest.load(); segment; ) {
+					auto next = segment->next();
+					delete segment;
+					segment = next;
+				}
+				while (_pool) {
+					auto next = _pool->next();
+					delete _pool;
+					_pool = next;
+				}
+			}
+
+			void start() {
+				auto segment = new Segment(SegmentSize, _queue->_backing, &_tally, _shared);
+				_newest.store(segment, std::memory_order_relaxed);
+				_oldest.store(segment, std::memory_order_relaxed);
+				_queue->_allocated += SegmentSize;
+			}
+
+			// must hold the chain lock
+			void dispose(Segment* segment) {
+				if (segment->spilled()) {
+					_queue->unspill(segment);
+				}
+				else {
+					delete segment;
+					_queue->unreserve(SegmentSize);
+				}
+			}
+
+			void init(Queue* queue, size_t index, size_t size, bool shared) {
+				assert(size <= Indicator::MaxSize);
+				_queue = queue;
+				_index = index;
+				SegmentSize = size;
+				_shared = shared;
+				start();
+			}
+
+			// as its entries' indicators record it
+			inline size_t index() const {
+				return _index;
+			}
+
+			// start over with a fresh segment, backed as the queue now says, but only while nothing is queued:
+			// a lane still holding messages keeps its segments, and only those it grows from now on are backed anew
+			bool renew() {
+				std::lock_guard<std::mutex> lock(_chain);
+				if (occupied() || _users)
+					return false;
+				for (auto segment = _oldest.load(std::memory_order_relaxed); segment; ) {
+					auto next = segment->next();
+					dispose(segment);
+					segment = next;
+				}
+				while (_pool) {
+					auto next = _pool->next();
+					dispose(_pool);
+					_pool = next;
+				}
+				_pooled = 0;
+				start();
+				return true;
+			}
+
+			inline size_t capacity() const {
+				return SegmentSize;
+			}
+
+			inline const Tally& tally() const {
+				return _tally;
+			}
+
+			// bytes claimed and not yet released
+			inline size_t occupied() const {
+				return _tally.claimed.load(std::memory_order_relaxed) - _tally.released.load(std::memory_order_relaxed);
+			}
+
+			// nothing claimed is still waiting to be popped
+			bool drained() const {
+				for (auto segment = _oldest.load(std::memory_order_acquire); segment; segment = segment->next())
+					if (!segment->drained())
+						return false;
+				return true;
+			}
+
+			inline bool owned(const Owner& producer) const {
+				return _owner.load(std::memory_order_relaxed) == producer.id();
+			}
+
+			// a producer lays claim to an unowned lane
+			bool adopt(Owner& producer) {
+				size_t owner = _owner.load(std::memory_order_relaxed);
+				if (owner != 0 || !_owner.compare_exchange_strong(owner, producer.id(), std::memory_order_acquire, std::memory_order_relaxed))
+					return false;
+				producer.adopted(&_owner);
+				return true;
+			}
+
+			// the lane is no one's to give up, once the queue is gone
+			void disown() {
+				owner().forget(&_owner);
 			}
 
+			// anyone other than the consumer must enter before touching segments, and leave when done
+			inline void enter() {
+				_users.fetch_add(1, std::memory_order_seq_cst);
+			}
+
+			inline void leave() {
+				_users.fetch_sub(1, std::memory_order_seq_cst);
+			}
+
+			Header* claim(size_t size) {
+				Tally::count(_tally.claims);
+				for (;;) {
+					enter();
+					auto segment = _newest.load(std::memory_order_seq_cst);
+					auto header = segment->claim(size);
+					leave();
+					if (header)
+						return header;
+					// someone may have grown the lane already, or retired the segment while we weren't looking
+					if (!grow(segment))
+						return NULL;
+				}
+			}
+
+			// says which segment it came from, for anyone but the consumer to release it by
+			Header* pop(Segment*& segment) {
+				segment = _oldest.load(std::memory_order_seq_cst);
+				for (;;) {
+					if (auto header = segment->pop())
+						return header;
+					// move along only once nothing more can arrive here
+					if (!segment->sealed() || !segment->drained())
+						return NULL;
+					if (!(segment = segment->next()))
+						return NULL;
+				}
+			}
+
+			void release(Header* header) {
+				segmentOf(header)->release(header);
+			}
+
+			Header* popRun(size_t& count, size_t& bytes, Segment*& segment) {
+				segment = _oldest.load(std::memory_order_acquire);
+				for (;;) {
+					if (auto first = segment->popRun(count, bytes))
+						return first;
+					if (!segment->sealed() || !segment->drained())
+						return NULL;
+					if (!(segment = segment->next()))
+						return NULL;
+				}
+			}
+
+			// the consumer lets go of old segments it is done with
+			void trim() {
+				Segment* oldest;
+				while ((oldest = _oldest.load(std::memory_order_relaxed))->sealed() && oldest->drained() && oldest->released()) {
+					std::lock_guard<std::mutex> lock(_chain);
+					_oldest.store(oldest->next(), std::memory_order_seq_cst);
+					retire(oldest);
+				}
+			}
+		};
+
+		Lane _shared;
+		Lane* _lanes;
+		size_t _laneCount;
+		size_t _next;
+		size_t _limit;
+		std::atomic<size_t> _allocated;
+		Backing _backing;
+
+		bool reserve(size_t size) {
+			if (_allocated.fetch_add(size) + size <= _limit)
+				return true;
+			_allocated -= size;
+			return false;
+		}
+
+		void unreserve(size_t size) {
+			_allocated -= size;
+		}
+
+		// Once the limit is reached, lanes may grow segments in files instead, up to a limit of their own
+		std::string _spillDirectory;
+		size_t _spillLimit;
+		std::atomic<size_t> _spillAllocated;
+		std::atomic<size_t> _spilled;
+		std::atomic<size_t> _drained;
+
+		Segment* spill(size_t size, Tally* tally, bool shared) {
+			if (_spillDirectory.empty())
+				return NULL;
+
+			if (_spillAllocated.fetch_add(size) + size > _spillLimit) {
+				_spillAllocated -= size;
+				return NULL;
+			}
+
+			auto file = new SpillFile(_spillDirectory, size);
+			if (!file->view()) {
+				delete file;
+				_spillAllocated -= size;
+				return NULL;
+			}
+			return new Segment(size, file, this, tally, shared);
+		}
+
+		void unspill(Segment* segment) {
+			_spillAllocated -= segment->capacity();
+			delete segment;
+		}
+
+		// the lane index follows the lanes, with the shared lane last
+		inline Lane& laneOf(const void* p) {
+			auto n = Header::Of(p)->get().lane();
+			return n < _laneCount ? _lanes[n] : _shared;
+		}
+
+		inline Lane& producerLane() {
+			auto& producer = owner();
+			if (_laneCount && !producer.shares(this)) {
+				// one lane to a producer, however many come free
+				for (size_t i = 0; i < _laneCount; ++i)
+					if (_lanes[i].owned(producer))
+						return _lanes[i];
+				for (size_t i = 0; i < _laneCount; ++i)
+					if (_lanes[i].adopt(producer))
+						return _lanes[i];
+				// more producers than lanes, so the rest share, for good
+				producer.share(this);
+			}
+			return _shared;
+		}
+
+		// allocate more than requested so we can place a header in front
+		static inline size_t outerSize(size_t size) {
+			return roundup(HeaderSize + size, BlockSize);
+		}
+
+		// Messages that can't be queued are built in thread-local scratch space instead,
+		// to be dropped or parked when they are pushed.
+		// A message too large for the space gets room on the heap, which the thread keeps for the next one.
+		static const size_t ScratchSize = 1024;
+
+		// the scratch space last handed out on this thread
+		static Header*& scratch() {
+			static threadlocal Header* header;
 			return header;
 		}
 
-		Header* claim(size_t size) {
+		static Header* scratch(size_t size) {
+			static threadlocal std::max_align_t space[ScratchSize / sizeof(std::max_align_t)];
+			static threadlocal void* large;
+			static threadlocal size_t largeSize;
+			auto header = (Header*)space;
+			if (size > ScratchSize) {
+				if (size > largeSize) {
+					auto grown = realloc(large, size);
+					if (!grown)
+						throw std::bad_alloc();
+					large = grown;
+					largeSize = size;
+				}
+				header = (Header*)large;
+			}
+			header->set(Indicator(size));
+			return scratch() = header;
+		}
+
+		// The latest message of each key, waiting for room in the queue.
+		// A slot is free when it has neither key nor size; once popped, it keeps its size until released.
+		struct Parked {
+			uint64_t key;
+			size_t size;
+			std::max_align_t data[ScratchSize / sizeof(std::max_align_t)];
+		};
+
+		static const size_t ParkedCount = 256;
+
+		// Parked messages take a turn once every so many popped from the lanes, so a busy queue can't starve them,
+		// and whenever the lanes have nothing to pop
+		static const size_t ParkedTurn = 64;
+
+		Overflow _overflow;
+		std::atomic<size_t> _dropped;
+		std::atomic<size_t> _sleeps;
+		std::atomic<size_t> _waiting;
+		std::atomic<bool> _interrupted;
+		std::mutex _mutex;
+		std::condition_variable _space;
+		std::mutex _parking;
+		Parked* _parked;
+		std::atomic<size_t> _parkedCount;
+		// for each slot, the bytes each lane had claimed when its message was parked
+		size_t* _parkedClaims;
+		// popped from the lanes since the parked messages' last turn; only the consumer counts them
+		size_t _sinceParked;
+
+		inline const Lane& lane(size_t i) const {
+			return i < _laneCount ? _lanes[i] : _shared;
+		}
+
+		void park(Header* header, uint64_t key) {
+			std::lock_guard<std::mutex> lock(_parking);
+			Parked* slot = NULL;
+			for (size_t i = 0; i < ParkedCount; ++i) {
+				if (_parked[i].key == key) {
+					// the message already parked is superseded
+					slot = &_parked[i];
+					++_dropped;
+					break;
+				}
+				if (!slot && _parked[i].key == 0 && _parked[i].size == 0)
+					slot = &_parked[i];
+			}
+			// a message too large for a slot is dropped, and takes the one it supersedes with it
+			auto size = header->get().size() - HeaderSize;
+			if (slot && size > sizeof(slot->data)) {
+				if (slot->key == key) {
+					slot->key = 0;
+					slot->size = 0;
+					--_parkedCount;
+				}
+				slot = NULL;
+			}
+			if (!slot) {
+				++_dropped;
+				return;
+			}
+			if (slot->key != key)
+				++_parkedCount;
+			slot->key = key;
+			slot->size = size;
+			auto claims = _parkedClaims + (slot - _parked) * (_laneCount + 1);
+			for (size_t i = 0; i <= _laneCount; ++i)
+				claims[i] = lane(i).tally().claimed.load(std::memory_order_relaxed);
+			memcpy(slot->data, header->payload(), slot->size);
+		}
+
+		void unpark(uint64_t key) {
+			std::lock_guard<std::mutex> lock(_parking);
+			for (size_t i = 0; i < ParkedCount; ++i) {
+				if (_parked[i].key == key) {
+					_parked[i].key = 0;
+					_parked[i].size = 0;
+					--_parkedCount;
+					++_dropped;
+					return;
+				}
+			}
+		}
+
+		// Parked messages are popped straight from their slots.
+		// Whatever the turn, one is popped only once everything claimed before it was parked has been released,
+		// so it can't overtake an older message with its key.
+		void* unpark() {
+			_sinceParked = 0;
+			std::lock_guard<std::mutex> lock(_parking);
+			for (size_t i = 0; i < ParkedCount; ++i) {
+				auto& slot = _parked[i];
+				if (slot.key && settled(_parkedClaims + i * (_laneCount + 1))) {
+					slot.key = 0;
+					--_parkedCount;
+					return slot.data;
+				}
+			}
+			return NULL;
+		}
+
+		bool settled(const size_t* claims) const {
+			for (size_t i = 0; i <= _laneCount; ++i)
+				if (lane(i).tally().released.load(std::memory_order_relaxed) < claims[i])
+					return false;
+			return true;
+		}
+
+		inline bool parkedTurn() const {
+			return _parkedCount && _sinceParked >= ParkedTurn;
+		}
+
+		inline bool parked(const void* p) const {
+			return p >= _parked && p < _parked + ParkedCount;
+		}
+
+		void unparked(void* p) {
+			std::lock_guard<std::mutex> lock(_parking);
+			_parked[((char*)p - (char*)_parked) / sizeof(Parked)].size = 0;
+		}
+
+		Header* retry(Lane& lane, size_t size) {
 			Header* header;
 			int tries = 100;
-			while (!(header = _claim(size)) && tries--)
+			while (!(header = lane.claim(size)) && tries--) {
+				++_sleeps;
 				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return header;
+		}
+
+		// waits as long as it takes, or until interrupted;
+		// the timed wait only covers a release that signals before we are waiting
+		Header* wait(Lane& lane, size_t size) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			++_waiting;
+			Header* header;
+			while (!(header = lane.claim(size)) && !_interrupted) {
+				++_sleeps;
+				_space.wait_for(lock, std::chrono::milliseconds(10));
+			}
+			--_waiting;
+			return header;
+		}
+
+		Header* evict(Lane& lane, size_t size) {
+			Header* header;
+			int tries = 100;
+			while (!(header = lane.claim(size))) {
+				// the chain may have moved on from the segment we found it in, so don't go looking for it
+				Segment* segment;
+				lane.enter();
+				auto oldest = lane.pop(segment);
+				if (oldest)
+					segment->release(oldest);
+				lane.leave();
+
+				if (oldest)
+					++_dropped;
+				// whatever is left is in the consumer's hands
+				else if (tries--) {
+					++_sleeps;
+					std::this_thread::yield();
+				}
+				else
+					break;
+			}
+			return header;
+		}
+
+		// returns NULL if the message is to be built in scratch space
+		Header* claim(Lane& lane, size_t size) {
+			auto header = lane.claim(size);
+			if (header)
+				return header;
+
+			switch (_overflow) {
+				case DropNewest:
+				case Conflate:
+					return NULL;
+				case Block:
+					header = wait(lane, size);
+					break;
+				case DropOldest:
+					header = evict(lane, size);
+					break;
+				default:
+					header = retry(lane, size);
+					break;
+			}
 			if (!header)
 				throw queue_overflow();
 			return header;
 		}
 
+		void signal() {
+			if (_waiting) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_space.notify_all();
+			}
+		}
+
+		// Only the consumer pops, and only the consumer keeps the high-water mark.
+		// Occupancy only falls when something is released, so looking just before then catches every peak
+		// (but those of evictions, which are overflowing anyway).
+		std::atomic<size_t> _popped;
+		std::atomic<size_t> _highWater;
+
+		inline void popped(size_t count) {
+			_popped.store(_popped.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+		}
+
+		void mark() {
+			auto bytes = occupied();
+			if (bytes > _highWater.load(std::memory_order_relaxed))
+				_highWater.store(bytes, std::memory_order_relaxed);
+		}
+
 	public:
-		Queue(size_t size) : BufferSize(size) {
+		// A queue of 'lanes' > 0 gives each of that many producer threads its own single-producer lane,
+		// plus the shared lane for any others.  Every lane starts as one segment of 'size' bytes,
+		// and may grow more segments as long as the queue's total stays within 'limit' bytes.
+		Queue(size_t size, size_t lanes = 0, size_t limit = 0) : _lanes(NULL), _laneCount(lanes), _next(0), _limit(limit), _spillLimit(0), _overflow(Throw), _parked(NULL), _parkedClaims(NULL), _sinceParked(0) {
 			assert(isPowerOf2(BlockSize));
-			assert(isPowerOf2(BufferSize));
-			_buffer = ::malloc(BufferSize);
-			zero(_buffer, BufferSize);
+			_allocated.store(0, std::memory_order_relaxed);
+			_spillAllocated.store(0, std::memory_order_relaxed);
+			_spilled.store(0, std::memory_order_relaxed);
+			_drained.store(0, std::memory_order_relaxed);
+			_dropped.store(0, std::memory_order_relaxed);
+			_waiting.store(0, std::memory_order_relaxed);
+			_interrupted.store(false, std::memory_order_relaxed);
+			_parkedCount.store(0, std::memory_order_relaxed);
+			_sleeps.store(0, std::memory_order_relaxed);
+			_popped.store(0, std::memory_order_relaxed);
+			_highWater.store(0, std::memory_order_relaxed);
+			assert(_laneCount < Indicator::MaxLanes);
+			_shared.init(this, _laneCount, size, true);
+			if (_laneCount) {
+				_lanes = new Lane[_laneCount];
+				for (size_t i = 0; i < _laneCount; ++i)
+					_lanes[i].init(this, i, size, false);
+			}
 		}
 
 		~Queue() {
-			::free(_buffer);
+			owner().unshare(this);
+			for (size_t i = 0; i < _laneCount; ++i)
+				_lanes[i].disown();
+			delete[] _lanes;
+			delete[] _parked;
+			delete[] _parkedClaims;
+		}
+
+		// choose the overflow policy before there are any producers
+		void overflow(Overflow policy) {
+			if (policy == Conflate && !_parked) {
+				_parked = new Parked[ParkedCount]();
+				_parkedClaims = new size_t[ParkedCount * (_laneCount + 1)]();
+			}
+			_overflow = policy;
+		}
+
+		Overflow overflow() const {
+			return _overflow;
+		}
+
+		// Producers blocked for room throw queue_overflow instead, and any that come after them, until resumed;
+		// so a consumer that is going away can still wait for its producers
+		void interrupt(bool on = true) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_interrupted = on;
+			_space.notify_all();
+		}
+
+		// the most memory the queue may grow to, at which point the overflow policy kicks in
+		void limit(size_t bytes) {
+			_limit = bytes;
+		}
+
+		size_t limit() const {
+			return _limit;
+		}
+
+		// choose how memory is backed before there are any producers; each lane with nothing queued starts over with it,
+		// and the others back only the segments they grow from now on, so a reconnect loses nothing not yet popped
+		void backing(const Backing& backing) {
+			if (backing == _backing)
+				return;
+			_backing = backing;
+			_shared.renew();
+			for (size_t i = 0; i < _laneCount; ++i)
+				_lanes[i].renew();
+		}
+
+		const Backing& backing() const {
+			return _backing;
+		}
+
+		size_t allocated() const {
+			return _allocated;
+		}
+
+		// beyond the limit, spill up to 'limit' more bytes into temporary files in 'directory'
+		void spill(const std::string& directory, size_t limit) {
+			_spillDirectory = directory;
+			_spillLimit = limit;
+		}
+
+		// bytes of messages that went to a file, and that have since been released from one
+		size_t spilled() const {
+			return _spilled;
+		}
+
+		size_t drained() const {
+			return _drained;
+		}
+
+		// how many messages the overflow policy has discarded
+		size_t dropped() const {
+			return _dropped;
+		}
+
+		// bytes claimed by producers and not yet released by the consumer
+		size_t occupied() const {
+			auto bytes = _shared.occupied();
+			for (size_t i = 0; i < _laneCount; ++i)
+				bytes += _lanes[i].occupied();
+			return bytes;
+		}
+
+		// A snapshot of the queue's counters, which are kept without locking anyone out,
+		// so they may be a little out of step with each other
+		struct Stats {
+			size_t allocated;	// bytes of memory backing the queue
+			size_t occupied;	// bytes waiting to be popped or released
+			size_t highWater;	// the most bytes ever occupied
+			size_t claims;		// times a producer laid claim to space
+			size_t collisions;	// times a claim lost a race with another producer, and tried again
+			size_t sleeps;		// times a producer waited for space
+			size_t wraps;		// times a claim skipped the end of a buffer
+			size_t popped;		// messages popped
+			size_t dropped;		// messages discarded by the overflow policy
+			size_t spilled;		// bytes that went to a file
+			size_t drained;		// bytes released from a file
+		};
+
+		// for the consumer's thread
+		Stats stats() {
+			mark();
+			Stats stats;
+			stats.allocated = _allocated;
+			stats.occupied = occupied();
+			stats.highWater = _highWater.load(std::memory_order_relaxed);
+			stats.claims = stats.collisions = stats.wraps = 0;
+			for (size_t i = 0; i <= _laneCount; ++i) {
+				auto& tally = (i < _laneCount ? _lanes[i] : _shared).tally();
+				stats.claims += tally.claims.load(std::memory_order_relaxed);
+				stats.collisions += tally.collisions.load(std::memory_order_relaxed);
+				stats.wraps += tally.wraps.load(std::memory_order_relaxed);
+			}
+			stats.sleeps = _sleeps;
+			stats.popped = _popped.load(std::memory_order_relaxed);
+			stats.dropped = _dropped;
+			stats.spilled = _spilled;
+			stats.drained = _drained;
+			return stats;
 		}
 
 		void* allocate(size_t size) {
-			// allocate more than requested so we can place a header in front
-			size = roundup(HeaderSize + size, BlockSize);
+			size = outerSize(size);
 
 			// lay claim to some memory
-			auto header = claim(size);
+			auto& lane = producerLane();
+			auto header = claim(lane, size);
+			if (!header)
+				return scratch(size)->payload();
 
 			// we now have exclusive write-access to our memory
 			// although others can read our header
 
-			header->release(Indicator(size));
+			header->set(Indicator(size, lane.index()));
 
 			// return the memory after our header
 			return header->payload();
 		}
 
-		void push(void* p) { 
+		// a non-zero key lets the Conflate policy replace an older message with the same key
+		void push(void* p, uint64_t key = 0) { 
 			// we have exclusive write-access to our memory
 			auto header = Header::Of(p);
+			if (header == scratch()) {
+				if (_overflow == Conflate && key)
+					park(header, key);
+				else
+					++_dropped;
+				return;
+			}
+
+			// a parked message with the same key is now out of date
+			if (key && _parkedCount)
+				unpark(key);
+
 			auto indicator = header->get();
-			header->release(indicator.commit());
+			header->publish(indicator.commit());
 		}
 
 		template<typename T> T* pop() { 
-			for(;;) {
-				Header* header;
-				Indicator indicator;
-
-				// lay claim to the entry pointed to by _tail
-				size_t tail = _tail;
-				do {
-					header = headerAt(tail);
-					indicator = header->acquire();
-					// if it's Free, then there's nothing to pop
-					if (indicator.free())
-						return NULL;
-				} while (!_tail.try_advance(tail, indicator.size(), BufferSize));
+			if (parkedTurn()) {
+				if (auto p = unpark()) {
+					popped(1);
+					return (T*)p;
+				}
+			}
 
-				// now we have exclusive write access
-				// although others can read our header
-				if (indicator.committed())
+			// visit every lane, starting where we left off, so no producer starves the others
+			auto lanes = _laneCount + 1;
+			for (size_t i = 0; i < lanes; ++i) {
+				auto n = (_next + i) % lanes;
+				auto& lane = n < _laneCount ? _lanes[n] : _shared;
+				Segment* segment;
+				if (auto header = lane.pop(segment)) {
+					_next = (n + 1) % lanes;
+					popped(1);
+					++_sinceParked;
 					return (T*)(header->payload());
+				}
+				// producers that evict may have emptied segments that no release of ours will trim
+				lane.trim();
+			}
 
-				// skip failed entries
-				_release(header, indicator.size());
+			if (_parkedCount) {
+				auto p = unpark();
+				if (p)
+					popped(1);
+				return (T*)p;
 			}
+			return NULL;
 		}
 
 		void release(void* p) { 
-			// we have exclusive write-access to our memory
-			auto header = Header::Of(p);
-			auto indicator = header->get();
-			_release(header, indicator.size());
+			if (_parked && parked(p))
+				return unparked(p);
+			mark();
+			auto& lane = laneOf(p);
+			lane.release(Header::Of(p));
+			lane.trim();
+			signal();
 		}
+
+		// A Run is the consumer's way of popping many messages at once.
+		// Each lane gives up a stretch of its messages with a single advance of its tail,
+		// and every stretch is released at once when the Run is done with.
+		// Messages stay valid until then.
+		class Run {
+			Run(const Run&) = delete;
+			Run& operator=(const Run&) = delete;
+
+			static const size_t SpanCount = 16;
+
+			// a stretch of one segment; or, without a segment, a parked message
+			struct Span {
+				Lane* lane;
+				Segment* segment;
+				Header* first;
+				size_t bytes;
+			};
+
+			Queue* _queue;
+			size_t _count;
+			size_t _popped;
+			Span _spans[SpanCount];
+			size_t _spanCount;
+			char* _next;
+			char* _end;
+
+			bool more() {
+				if (_spanCount == SpanCount)
+					return false;
+				if (_queue->parkedTurn() && parked())
+					return true;
+				auto& span = _spans[_spanCount];
+
+				// visit every lane, starting where we left off, so no producer starves the others
+				auto lanes = _queue->_laneCount + 1;
+				for (size_t i = 0; i < lanes; ++i) {
+					auto n = (_queue->_next + i) % lanes;
+					auto& lane = n < _queue->_laneCount ? _queue->_lanes[n] : _queue->_shared;
+					size_t count = _count;
+					if ((span.first = lane.popRun(count, span.bytes, span.segment))) {
+						_queue->_next = (n + 1) % lanes;
+						span.lane = &lane;
+						++_spanCount;
+						_count -= count;
+						_queue->_sinceParked += count;
+						_next = (char*)span.first;
+						_end = _next + span.bytes;
+						return true;
+					}
+					lane.trim();
+				}
+
+				return _queue->_parkedCount && parked();
+			}
+
+			bool parked() {
+				auto p = _queue->unpark();
+				if (!p)
+					return false;
+				auto& span = _spans[_spanCount];
+				span.lane = NULL;
+				span.segment = NULL;
+				span.first = (Header*)p;
+				++_spanCount;
+				--_count;
+				_next = (char*)p;
+				_end = NULL;
+				return true;
+			}
+
+		public:
+			// pops no more than 'count' messages
+			Run(Queue& queue, size_t count) : _queue(&queue), _count(count), _popped(0), _spanCount(0), _next(NULL), _end(NULL) {}
+
+			// pops nothing, until it's given a queue
+			Run() : _queue(NULL), _count(0), _popped(0), _spanCount(0), _next(NULL), _end(NULL) {}
+
+			~Run() {
+				release();
+			}
+
+			void from(Queue& queue) {
+				_queue = &queue;
+			}
+
+			// pops no more than 'count' messages from now on
+			void allow(size_t count) {
+				_count = count;
+			}
+
+			template<typename T> T* pop() {
+				for (;;) {
+					// a parked message stands alone
+					if (_next && !_end) {
+						auto p = _next;
+						_next = NULL;
+						++_popped;
+						return (T*)p;
+					}
+
+					// skip failed entries
+					while (_next < _end) {
+						auto header = (Header*)_next;
+						auto indicator = header->get();
+						_next += indicator.size();
+						if (indicator.committed()) {
+							++_popped;
+							return (T*)(header->payload());
+						}
+					}
+
+					if (!_count || !more())
+						return NULL;
+				}
+			}
+
+			void release() {
+				if (!_spanCount)
+					return;
+				_queue->popped(_popped);
+				_popped = 0;
+				_queue->mark();
+				for (size_t i = 0; i < _spanCount; ++i) {
+					auto& span = _spans[i];
+					if (!span.segment) {
+						_queue->unparked(span.first);
+						continue;
+					}
+					span.segment->releaseRun(span.first, span.bytes);
+					span.lane->trim();
+				}
+				_spanCount = 0;
+				_next = _end = NULL;
+				_queue->signal();
+			}
+		};
+
+		// A Batch lays claim to room for many messages at once, and they are built in place.
+		// Nothing is visible to the consumer until commit() publishes them all with a single release.
+		// If the messages outgrow the room, what's built so far is committed, and more is claimed.
+		class Batch {
+			Batch(const Batch&) = delete;
+			Batch& operator=(const Batch&) = delete;
+
+			Queue& _queue;
+			Lane& _lane;
+			size_t _count;
+			size_t _size;
+			Header* _first;
+			char* _next;
+			char* _end;
+
+			void reserve(size_t size) {
+				// room for the rest of the messages, but not so much that we hog the lane
+				auto bytes = (_count ? _count : 1) * _size;
+				auto limit = _lane.capacity() / 4;
+				if (bytes > limit)
+					bytes = limit;
+				if (bytes < size)
+					bytes = size;
+
+				_first = _queue.claim(_lane, bytes);
+				_next = (char*)_first;
+				_end = _first ? _next + bytes : NULL;
+			}
+
+			// the headers after the first are stamped from it
+			void follow(Header* header) {
+				header->stamp().claim(Place::after(_first->position(), (char*)header - (char*)_first), true);
+			}
+
+		public:
+			// 'count' messages are expected, none larger than 'size'
+			Batch(Queue& queue, size_t count, size_t size) :
+				_queue(queue),
+				_lane(queue.producerLane()),
+				_count(count),
+				_size(outerSize(size)),
+				_first(NULL), _next(NULL), _end(NULL)
+			{}
+
+			~Batch() {
+				commit();
+			}
+
+			void* allocate(size_t size) {
+				size = outerSize(size);
+				if (_next + size > _end) {
+					commit();
+					reserve(size);
+				}
+
+				// the overflow policy is dropping messages
+				if (!_first) {
+					++_queue._dropped;
+					return scratch(size)->payload();
+				}
+
+				auto header = (Header*)_next;
+				_next += size;
+				if (_count)
+					--_count;
+
+				// the consumer can't get past the first header until it is published,
+				// so the ones after it can be marked committed and published already
+				if (header == _first) {
+					header->set(Indicator(size, _lane.index()));
+				}
+				else {
+					follow(header);
+					header->set(Indicator(size, _lane.index()).commit());
+				}
+
+				return header->payload();
+			}
+
+			void discard(void* p) {
+				auto header = Header::Of(p);
+				header->set(header->get().fail());
+			}
+
+			void commit() {
+				if (!_first)
+					return;
+
+				// whatever room is left over gets skipped
+				auto filler = (Header*)_next;
+				if (_next < _end) {
+					if (filler != _first)
+						follow(filler);
+					filler->set(Indicator(_end - _next).fail());
+				}
+
+				if (filler == _first) {
+					_first->publish(_first->get());
+				}
+				else {
+					auto indicator = _first->get();
+					_first->publish(indicator.failed() ? indicator : indicator.commit());
+				}
+
+				_first = NULL;
+				_next = _end = NULL;
+			}
+		};
 	};
 
 }
 
+#undef threadlocal
 #undef isPowerOf2
 #undef mod
 #undef roundup
@@ -0,0 +1,101 @@
+// A standalone driver for the queue's shared lane: any number of producer threads, and one consumer popping in runs,
+// as the addon's SDK threads and its callback do.  It isn't part of the addon; build it on its own, optimized, e.g.
+//	cl /EHsc /O2 /I<ActiveTick SDK include> queuebench.cpp
+// and run it as
+//	queuebench [producers [messages per producer [message size]]]
+// It measures whatever queue.h it's built with, so the same driver compares one claim against another:
+// build it once more against an earlier revision's queue.h, and run both on the same machine.
+// Producers only contend when they run at the same time, so give it more cores than producers, or the numbers say little.
+#include <stdexcept>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <ActiveTickServerAPI.h>
+#include "exception.h"
+#include "backing.h"
+#include "queue.h"
+
+using namespace ActiveTickServerAPI_node;
+
+struct Result {
+	double nsPerMessage;
+	size_t collisions;
+};
+
+// one run: every producer pushes 'count' messages of 'size' bytes, on the shared lane only, while this thread pops them
+static Result run(int producers, long count, size_t size) {
+	Queue queue(1 * 1024 * 1024, 0, 64 * 1024 * 1024);
+	std::atomic<bool> go(false);
+	std::atomic<int> done(0);
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p) {
+		threads.push_back(std::thread([&] {
+			while (!go.load())
+				std::this_thread::yield();
+			for (long i = 0; i < count; ++i) {
+				void* message;
+				for (;;) {
+					try {
+						message = queue.allocate(size);
+						break;
+					}
+					catch (queue_overflow&) {
+						std::this_thread::yield();
+					}
+				}
+				*(long*)message = i;
+				queue.push(message);
+			}
+			++done;
+		}));
+	}
+
+	auto total = (long)producers * count;
+	long popped = 0;
+	auto start = std::chrono::steady_clock::now();
+	go = true;
+	while (popped < total) {
+		Queue::Run run(queue, 4096);
+		while (run.pop<long>())
+			++popped;
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	for (auto& thread : threads)
+		thread.join();
+
+	Result result;
+	result.nsPerMessage = std::chrono::duration<double, std::nano>(elapsed).count() / total;
+	result.collisions = queue.stats().collisions;
+	return result;
+}
+
+int main(int argc, char** argv) {
+	int producers = argc > 1 ? atoi(argv[1]) : 0;
+	long count = argc > 2 ? atol(argv[2]) : 1000000;
+	size_t size = argc > 3 ? (size_t)atol(argv[3]) : 32;
+	auto cores = std::thread::hardware_concurrency();
+
+	printf("%u cores, %ld messages of %u bytes per producer, best of 3\n", cores, count, (unsigned)size);
+	if (cores < 2)
+		printf("with one core, producers only contend when one is preempted mid-claim, so this says little about contention\n");
+
+	// with no count of producers given, 1, 2, 4 and so on, up to one fewer than the cores, for the consumer
+	int from = producers ? producers : 1;
+	int to = producers ? producers : (cores > 2 ? (int)cores - 1 : 1);
+	for (int p = from; p <= to; p *= 2) {
+		Result best = run(p, count, size);
+		for (int i = 1; i < 3; ++i) {
+			auto result = run(p, count, size);
+			if (result.nsPerMessage < best.nsPerMessage)
+				best = result;
+		}
+		printf("producers %2d  %7.1f ns/message  %6.2f M messages/s  collisions %u\n",
+			p, best.nsPerMessage, 1000 / best.nsPerMessage, (unsigned)best.collisions);
+	}
+	return 0;
+}
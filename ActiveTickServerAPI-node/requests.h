@@ -0,0 +1,114 @@
+namespace ActiveTickServerAPI_node {
+	using namespace v8;
+
+	// The requests in flight, each known to scripts by a small number, its handle, rather than by the API's 64-bit id,
+	// and each with the function, if any, that its messages go straight to.
+	// A request stays until it's forgotten, or until its last message is delivered;
+	// messages that come for a request after that are dropped.  Main thread only.
+	class Requests {
+		static const uint32_t Capacity = 4096;
+
+		// Requests are found by their ids in an open-addressed index of handles, with twice the places there are slots,
+		// so a probe rarely goes past a place or two
+		static const uint32_t IndexBits = 13;
+		static const uint32_t IndexSize = 1 << IndexBits;
+		static const uint32_t IndexMask = IndexSize - 1;
+		static_assert(IndexSize >= 2 * Capacity, "the index is too small for the slots");
+
+		struct Slot {
+			uint64_t request;	// 0 when free
+			uint32_t next;	// the next free slot
+			Persistent<Function> handler;
+		};
+
+		Slot _slots[Capacity];	// slot 0 is never used, so that no handle is 0
+		uint32_t _index[IndexSize];	// 0 where empty
+		uint32_t _free;
+		uint32_t _used;	// every slot from here on has never been used
+		uint32_t _last;	// the slot last found, since a request's messages tend to come together
+
+		static inline uint32_t place(uint64_t request) {
+			return (uint32_t)((request * 0x9E3779B97F4A7C15ull) >> (64 - IndexBits));
+		}
+
+		// the index place holding the handle, or that would
+		uint32_t placeOf(uint64_t request) const {
+			auto i = place(request);
+			while (_index[i] && _slots[_index[i]].request != request)
+				i = (i + 1) & IndexMask;
+			return i;
+		}
+
+		// Linear probing leaves no gaps in a run of places, so the entries after the one taken out
+		// move back into the gap, unless their own place lies between it and them
+		void unindex(uint32_t gap) {
+			for (auto i = (gap + 1) & IndexMask; _index[i]; i = (i + 1) & IndexMask) {
+				auto home = place(_slots[_index[i]].request);
+				if (((i - home) & IndexMask) >= ((i - gap) & IndexMask)) {
+					_index[gap] = _index[i];
+					gap = i;
+				}
+			}
+			_index[gap] = 0;
+		}
+
+	public:
+		Requests() : _free(0), _used(1), _last(0) {
+			memset(_slots, 0, sizeof(_slots));
+			memset(_index, 0, sizeof(_index));
+		}
+
+		// the new request's handle, or 0 if there are too many in flight
+		uint32_t add(uint64_t request, Handle<Value> handler) {
+			uint32_t handle = _free;
+			if (handle)
+				_free = _slots[handle].next;
+			else if (_used < Capacity)
+				handle = _used++;
+			else
+				return 0;
+
+			auto& slot = _slots[handle];
+			slot.request = request;
+			_index[placeOf(request)] = handle;
+			if (handler->IsFunction())
+				slot.handler = Persistent<Function>::New(handler.As<Function>());
+			return handle;
+		}
+
+		// the request's handle, or 0 if it's gone
+		uint32_t find(uint64_t request) {
+			if (_slots[_last].request == request)
+				return _last;
+			auto handle = _index[placeOf(request)];
+			if (handle)
+				_last = handle;
+			return handle;
+		}
+
+		// empty if the request's messages go to the callback with all the rest
+		Handle<Function> handler(uint32_t handle) const {
+			return _slots[handle].handler;
+		}
+
+		void remove(uint32_t handle) {
+			if (handle == 0 || handle >= _used || !_slots[handle].request)
+				return;
+			auto& slot = _slots[handle];
+			unindex(placeOf(slot.request));
+			slot.request = 0;
+			slot.handler.Dispose();
+			slot.handler.Clear();
+			slot.next = _free;
+			_free = handle;
+			if (_last == handle)
+				_last = 0;
+		}
+
+		// once its last message is delivered, unless its handle has gone to another request meanwhile
+		void end(uint32_t handle, uint64_t request) {
+			if (handle < _used && _slots[handle].request == request)
+				remove(handle);
+		}
+	};
+}
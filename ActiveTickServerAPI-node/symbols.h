@@ -0,0 +1,118 @@
+#include <atomic>
+#include <cwchar>
+
+namespace ActiveTickServerAPI_node {
+	using namespace v8;
+
+	// Symbols, each numbered once, densely and from 1, with its string made once and kept for good.
+	// Any thread may look a symbol up, or add it, so that producers can number every update as they queue it;
+	// adding takes a spin lock, which only ever waits on another thread adding at the same moment.
+	// The strings are made on the main thread, which catches up with whatever's been added before it delivers anything.
+	// A number is never reused, so scripts can keep things in arrays by it.
+	class Symbols {
+		Symbols(const Symbols&) = delete;
+		Symbols& operator=(const Symbols&) = delete;
+
+	public:
+		static const uint32_t Capacity = 16384;
+		static const size_t Length = sizeof(((ATSYMBOL*)0)->symbol) / sizeof(wchar16_t);
+
+	private:
+		static const uint32_t Slots = 2 * Capacity;	// a power of 2, kept at most half full
+
+		// each slot is the number of a symbol, or 0 when empty; it is published once the symbol's text is in place
+		std::atomic<uint32_t> _slots[Slots];
+		wchar16_t _text[Capacity][Length];
+		std::atomic<uint32_t> _count;
+		std::atomic<bool> _adding;
+		uint32_t _made;	// the main thread has made the strings of the symbols numbered below this
+		Persistent<String> _strings[Capacity];
+		Persistent<Array> _array;
+
+		static uint32_t hash(const wchar16_t* symbol) {
+			// FNV-1a
+			uint32_t hash = 2166136261u;
+			for (auto c = symbol; *c; ++c) {
+				hash ^= *c;
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+	public:
+		Symbols() : _count(1), _adding(false), _made(1) {
+			for (uint32_t i = 0; i < Slots; ++i)
+				_slots[i].store(0, std::memory_order_relaxed);
+		}
+
+		// the symbol's number, or 0 if it hasn't been added; from any thread
+		uint32_t find(const wchar16_t* symbol) const {
+			for (auto i = hash(symbol); ; ++i) {
+				auto id = _slots[i & (Slots - 1)].load(std::memory_order_acquire);
+				if (!id)
+					return 0;
+				if (!wcsncmp(_text[id], symbol, Length))
+					return id;
+			}
+		}
+
+		// the symbol's number, adding it if need be, or 0 if there's no more room; from any thread
+		uint32_t add(const wchar16_t* symbol) {
+			if (auto id = find(symbol))
+				return id;
+
+			while (_adding.exchange(true, std::memory_order_acquire))
+				;
+			uint32_t id;
+			for (auto i = hash(symbol); ; ++i) {
+				auto& slot = _slots[i & (Slots - 1)];
+				id = slot.load(std::memory_order_relaxed);
+				if (!id) {
+					id = _count.load(std::memory_order_relaxed);
+					if (id == Capacity) {
+						id = 0;
+						break;
+					}
+					wcsncpy(_text[id], symbol, Length - 1);
+					_count.store(id + 1, std::memory_order_release);
+					slot.store(id, std::memory_order_release);
+					break;
+				}
+				if (!wcsncmp(_text[id], symbol, Length))
+					break;
+			}
+			_adding.store(false, std::memory_order_release);
+			return id;
+		}
+
+		// makes the strings of the symbols added since last time; main thread only
+		void catchUp() {
+			auto count = _count.load(std::memory_order_acquire);
+			for (; _made < count; ++_made) {
+				_strings[_made] = Persistent<String>::New(v8string(_text[_made]));
+				if (!_array.IsEmpty())
+					_array->Set(_made, _strings[_made]);
+			}
+		}
+
+		// main thread only
+		Handle<String> string(uint32_t id) {
+			if (id >= _made)
+				catchUp();
+			return _strings[id];
+		}
+
+		// every symbol's string, by number, kept up to date as the main thread catches up, for scripts
+		Handle<Array> array() {
+			if (_array.IsEmpty()) {
+				_array = Persistent<Array>::New(Array::New());
+				for (uint32_t id = 1; id < _made; ++id)
+					_array->Set(id, _strings[id]);
+			}
+			catchUp();
+			return _array;
+		}
+	};
+
+	static Symbols symbolTable;
+}
@@ -1,13 +1,41 @@
 "use strict";
 
 var api = require("./bin/ActiveTickServerAPI.node")
+var binary = require("./binary")
 
 function noop() {}
 function invoke(action) { return action() }
 
+// names for the codes in columnar batches and records, and for the bits of conditions and flags
+exports.exchanges = api.exchanges
+exports.tradeConditions = api.tradeConditions
+exports.quoteConditions = api.quoteConditions
+exports.tradeFlags = api.tradeFlags
+
+// a fixed-point price, from { fixedPoint: true }, as an exact decimal string
+exports.decimal = api.decimal
+
+function flagBits(names) {
+	return api.tradeFlags.reduce(function(bits, name, bit) {
+		return names.indexOf(name) < 0 ? bits : bits | (1 << bit)
+	}, 0)
+}
+
+var extendedFlags = flagBits(['preMarketVolume', 'afterMarketVolume'])
+
+// the names of the bits set in a conditions or flags bitmask, looked up in one of the tables above;
+// conditions reach past 32 bits, where bitwise operators can't go
+exports.names = function names(bits, table) {
+	var names = []
+	for (var bit = 0; bits; ++bit, bits = Math.floor(bits / 2))
+		if (bits % 2 && table[bit])
+			names.push(table[bit])
+	return names
+}
+
 var connection = null
 
-exports.connect = function connect(credentials, callback, debug) {
+exports.connect = function connect(credentials, callback, debug, options) {
 	if (connection)
 		throw new Error('Already connected')
 	if (!credentials || !credentials.apikey || !credentials.username || !credentials.password)
@@ -15,7 +43,8 @@ exports.connect = function connect(credentials, callback, debug) {
 
 	var connected = false, loggedIn = false
 	var subscriptions = {}
-	var requests = {}
+	// the same listeners, by symbol number, which is how messages are dispatched to them
+	var listeners = []
 	var queue = [subscribeAll]
 
 	function subscribeAll() {
@@ -27,6 +56,7 @@ exports.connect = function connect(credentials, callback, debug) {
 		for (var symbol in subscriptions)
 			api.unsubscribe(symbol)
 		subscriptions = {}
+		listeners = []
 	}
 	
 	function onError(message) {
@@ -37,8 +67,7 @@ exports.connect = function connect(credentials, callback, debug) {
 	function onStatusChange(message) {
 		if (message.sessionStatus === 'connected') {
 			connected = true
-			var request = api.logIn(credentials.username, credentials.password)
-			requests[request] = onLogin
+			api.logIn(credentials.username, credentials.password, traced(onLogin))
 		} else {
 			connected = loggedIn = false
 		}
@@ -46,7 +75,7 @@ exports.connect = function connect(credentials, callback, debug) {
 	}
 
 	function onLogin(message) {
-		delete requests[message.request]
+		api.forget(message.request)
 		if (message.loginResponse === 'success') {
 			loggedIn = true
 			queue.forEach(invoke)
@@ -56,15 +85,95 @@ exports.connect = function connect(credentials, callback, debug) {
 	}
 
 	function onTrade(message) {
-		var listener = subscriptions[message.symbol]
+		var listener = listeners[message.symbolId]
 		listener && listener(simpleTrade(message.symbol, message))
 	}
 
 	function onQuote(message) {
-		var listener = subscriptions[message.symbol]
+		var listener = listeners[message.symbolId]
 		listener && listener(simpleQuote(message.symbol, message))
 	}
 
+	// with { columnar: true }, the whole batch goes to the callback, and each row to its symbol's listener
+	function onTrades(batch) {
+		callback && callback(batch)
+		for (var i = 0; i < batch.count; ++i) {
+			var listener = listeners[batch.symbol[i]]
+			if (listener) {
+				var record = {
+					symbol: api.symbols[batch.symbol[i]],
+					time: batch.time[i],
+					trade: batch.lastPrice[i],
+					size: batch.lastSize[i],
+				}
+				if (batch.flags[i] & extendedFlags)
+					record.extended = true
+				if (batch.precision)
+					record.precision = batch.precision[i]
+				listener(record)
+			}
+		}
+	}
+
+	function onQuotes(batch) {
+		callback && callback(batch)
+		for (var i = 0; i < batch.count; ++i) {
+			var listener = listeners[batch.symbol[i]]
+			if (listener) {
+				var record = {
+					symbol: api.symbols[batch.symbol[i]],
+					time: batch.time[i],
+					bid: batch.bidPrice[i],
+					ask: batch.askPrice[i],
+				}
+				if (batch.precision)
+					record.precision = batch.precision[i]
+				listener(record)
+			}
+		}
+	}
+
+	// with { binary: true }, the whole Buffer goes to the callback, and each record to its symbol's listener
+	function onRecords(buffer) {
+		callback && callback(buffer)
+		var count = binary.count(binary.check(buffer))
+		var fixedPoint = binary.fixedPoint(buffer)
+		for (var i = 0; i < count; ++i) {
+			var offset = binary.offset(buffer, i)
+			var id = binary.symbolId(buffer, offset)
+			var listener = listeners[id]
+			if (!listener)
+				continue
+			var symbol = api.symbols[id]
+			switch (binary.type(buffer, offset)) {
+				case binary.Trade:
+					var record = {
+						symbol: symbol,
+						time: binary.time(buffer, offset),
+						trade: binary.price(buffer, offset),
+						size: binary.size(buffer, offset),
+					}
+					if (binary.flags(buffer, offset) & extendedFlags)
+						record.extended = true
+					if (fixedPoint)
+						record.precision = binary.precision(buffer, offset)
+					listener(record)
+					break
+				case binary.Quote:
+					var record = {
+						symbol: symbol,
+						time: binary.time(buffer, offset),
+						bid: binary.price(buffer, offset),
+						ask: binary.askPrice(buffer, offset),
+					}
+					if (fixedPoint)
+						record.precision = binary.precision(buffer, offset)
+					listener(record)
+					break
+			}
+		}
+	}
+
 	function simpleTrade(symbol, message) {
 		var record = {
 			symbol: symbol,
@@ -72,18 +181,24 @@ exports.connect = function connect(credentials, callback, debug) {
 			trade: message.lastPrice,
 			size: message.lastSize,
 		}
-		if (message.preMarketVolume || message.afterMarketVolume)
+		var flags = message.flags
+		if (typeof flags === 'number' ? flags & extendedFlags : flags && (flags.preMarketVolume || flags.afterMarketVolume))
 			record.extended = true
+		if (message.precision !== undefined)
+			record.precision = message.precision
 		return record
 	}
 
 	function simpleQuote(symbol, message) {
-		return {
+		var record = {
 			symbol: symbol,
 			time: message.time,
 			bid: message.bidPrice,
 			ask: message.askPrice,
 		}
+		if (message.precision !== undefined)
+			record.precision = message.precision
+		return record
 	}
 	
 	function ohlc(symbol, message) {
@@ -104,11 +219,23 @@ exports.connect = function connect(credentials, callback, debug) {
 		"server-time-update": noop,
 		"stream-update-trade": onTrade,
 		"stream-update-quote": onQuote,
+		"stream-update-trades": onTrades,
+		"stream-update-quotes": onQuotes,
+		"stream-update-records": onRecords,
+	}
+
+	// a request's messages go straight to the handler it was made with, and so skip receive()
+	function traced(handler) {
+		return function(message) {
+			debug && debug(message)
+			handler(message)
+		}
 	}
 
 	function receive(message) {
 		debug && debug(message)
-		var handler = (message.request? requests[message.request]: handlers[message.message] || callback) || noop
+		// those of requests made without a handler, such as subscribing, are of no interest
+		var handler = (message.request? noop: handlers[message.message] || callback) || noop
 		handler(message)
 	}
 
@@ -129,13 +256,15 @@ exports.connect = function connect(credentials, callback, debug) {
 		if (subscriptions[symbol])
 			throw new Error('already subscribed: ' + symbol)
 
-		subscriptions[symbol] = listener
+		var id = api.symbolId(symbol)
+		subscriptions[symbol] = listeners[id] = listener
 		if (loggedIn)
 			api.subscribe(symbol)
 
 		return function unsubscribe() {
 			if (subscriptions[symbol]) {
 				delete subscriptions[symbol]
+				listeners[id] = undefined
 				api.unsubscribe(symbol)
 			}
 		}
@@ -156,7 +285,7 @@ exports.connect = function connect(credentials, callback, debug) {
 				debug && debug(message)
 
 				if (message.error && message.error !== 'symbol-status invalid') {
-					delete requests[message.request]
+					api.forget(message.request)
 					return listener && listener({ error: message.error, message: message, records: records })
 				}
 
@@ -168,7 +297,7 @@ exports.connect = function connect(credentials, callback, debug) {
 				
 				ended || (ended = message.end)
 				if (ended && last) {
-					delete requests[message.request]
+					api.forget(message.request)
 					return listener && listener({ completed: true, records: records })
 				}
 			}	
@@ -178,8 +307,7 @@ exports.connect = function connect(credentials, callback, debug) {
 			if (begin >= endOfDay) return false
 			whenLoggedIn(function() {
 //				console.log('requesting', begin)
-				request = api.quotes(symbol, begin, begin + interval)
-				requests[request] = dispatcher(begin)
+				request = api.quotes(symbol, begin, begin + interval, traced(dispatcher(begin)))
 //				console.log('requested', request, begin)
 			})
 			return true
@@ -188,7 +316,7 @@ exports.connect = function connect(credentials, callback, debug) {
 		requestTicks(startOfDay)
 
 		return function() {
-			request && delete requests[request]
+			request && api.forget(request)
 			return listener && listener({ cancelled: true, records: records })
 		}
 	}
@@ -239,19 +367,14 @@ exports.connect = function connect(credentials, callback, debug) {
 		}
 
 		function requestBars() {
-			request = api.bars(symbol, begin, end)
-			requests[request] = dispatch
+			request = api.bars(symbol, begin, end, traced(dispatch))
 		}
 
 		whenLoggedIn(requestBars)
 
-		function clear(request) {
-			delete requests[request]
-		}
-
+		// anything still to come for the request is dropped
 		function cancel() {
-			setTimeout(clear.bind(null, request), 10000).unref()
-			requests[request] = noop
+			request && api.forget(request)
 		}
 
 		return function() {
@@ -267,7 +390,7 @@ exports.connect = function connect(credentials, callback, debug) {
 			debug && debug(message)
 
 			if (message.error) {
-				delete requests[message.request]
+				api.forget(message.request)
 				return listener && listener({ error: message.error, message: message, records: records })
 			}
 
@@ -280,7 +403,7 @@ exports.connect = function connect(credentials, callback, debug) {
 			}
 
 			if (message.end) {
-				delete requests[message.request]
+				api.forget(message.request)
 				return listener && listener({ completed: true, records: records })
 			}
 		}
@@ -291,14 +414,13 @@ exports.connect = function connect(credentials, callback, debug) {
 
 		function requestHolidays() {
 			var relativeYear = year - thisYear()
-			request = api.holidays(relativeYear)
-			requests[request] = dispatch
+			request = api.holidays(relativeYear, traced(dispatch))
 		}
 		
 		whenLoggedIn(requestHolidays)
 
 		return function() {
-			request && delete requests[request]
+			request && api.forget(request)
 			return listener && listener({ cancelled: true, records: records })
 		}
 	}
@@ -311,13 +433,33 @@ exports.connect = function connect(credentials, callback, debug) {
 
 	connection = {
 		disconnect: disconnect,
+		stats: api.stats,
 		subscribe: subscribe,
 		quotes: quotes,
 		daily: daily,
 		holidays: holidays,
 	}
 
-	api.connect(credentials.apikey, receiveMessages)
+	api.connect(credentials.apikey, receiveMessages, options)
 	return connection
 
 }
+
+// Follow the live stream of another process that connected with { broadcast: name }.
+// Returns a function to stop listening.
+exports.listen = function listen(name, listener, interval) {
+	var reader = api.attach(name)
+
+	function poll() {
+		var messages
+		while ((messages = reader.read(1024)).length) {
+			for (var i = 0; i < messages.length; ++i)
+				listener(messages[i])
+		}
+	}
+
+	var timer = setInterval(poll, interval || 10)
+	return function stop() {
+		clearInterval(timer)
+	}
+}
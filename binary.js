@@ -0,0 +1,131 @@
+"use strict";
+
+// Reads the Buffers that come to the callback with { binary: true }:
+// a header, then fixed-size records, laid out as ActiveTickServerAPI-node/binary.h describes.
+// Records are addressed by their byte offset, so a reader can pick out just the fields it wants.
+
+var Magic = 0x42425441	// "ATBB"
+var Version = 2
+var HeaderSize = 16
+var FixedPoint = 1
+
+var Trade = exports.Trade = 9
+var Quote = exports.Quote = 10
+
+// throws unless the buffer is one this version can read
+exports.check = function check(buffer) {
+	if (buffer.length < HeaderSize || buffer.readUInt32LE(0) !== Magic)
+		throw new Error('not a record buffer')
+	if (buffer.readUInt16LE(4) !== Version)
+		throw new Error('unsupported record buffer version ' + buffer.readUInt16LE(4))
+	return buffer
+}
+
+exports.count = function count(buffer) {
+	return buffer.readUInt32LE(8)
+}
+
+// true when prices are integers in units of 10^-precision
+exports.fixedPoint = function fixedPoint(buffer) {
+	return (buffer.readUInt32LE(12) & FixedPoint) !== 0
+}
+
+// the offset of record 'index'
+exports.offset = function offset(buffer, index) {
+	return HeaderSize + index * buffer.readUInt16LE(6)
+}
+
+exports.type = function type(buffer, offset) {
+	return buffer[offset]
+}
+
+// the symbol's number, which the module's symbols table turns into its string
+exports.symbolId = function symbolId(buffer, offset) {
+	return buffer.readUInt32LE(offset + 4)
+}
+
+// milliseconds since the epoch
+exports.time = function time(buffer, offset) {
+	return buffer.readDoubleLE(offset + 8)
+}
+
+// a fixed-point price, exact while under 2^53
+function scaled(buffer, offset) {
+	return buffer.readInt32LE(offset + 4) * 4294967296 + buffer.readUInt32LE(offset)
+}
+
+// the trade's price, or the bid
+exports.price = function price(buffer, offset) {
+	return exports.fixedPoint(buffer) ? scaled(buffer, offset + 16) : buffer.readDoubleLE(offset + 16)
+}
+
+exports.askPrice = function askPrice(buffer, offset) {
+	return exports.fixedPoint(buffer) ? scaled(buffer, offset + 24) : buffer.readDoubleLE(offset + 24)
+}
+
+// the number of decimal places in the prices
+exports.precision = function precision(buffer, offset) {
+	return buffer[offset + 3]
+}
+
+// the trade's size, or the bid's
+exports.size = function size(buffer, offset) {
+	return buffer.readUInt32LE(offset + 32)
+}
+
+exports.askSize = function askSize(buffer, offset) {
+	return buffer.readUInt32LE(offset + 36)
+}
+
+exports.flags = function flags(buffer, offset) {
+	return buffer.readUInt32LE(offset + 40)
+}
+
+// the condition codes, four of a trade's and one of a quote's, as the bitmask a message has: bit n for code n,
+// reaching past 32 bits, where bitwise operators can't go
+exports.conditions = function conditions(buffer, offset) {
+	var bits = 0
+	for (var i = 0, count = buffer[offset] === Trade ? 4 : 1; i < count; ++i) {
+		var code = buffer[offset + 44 + i], bit = Math.pow(2, code)
+		if (code > 0 && code < 53 && Math.floor(bits / bit) % 2 === 0)
+			bits += bit
+	}
+	return bits
+}
+
+// The whole record, with the same field names and meanings as a message's, except that exchanges stay codes.
+// Pass the module's symbols table to have the symbol's string too.
+exports.read = function read(buffer, offset, symbols) {
+	var symbolId = exports.symbolId(buffer, offset)
+	switch (buffer[offset]) {
+		case Trade:
+			return {
+				message: 'stream-update-trade',
+				symbol: symbols && symbols[symbolId],
+				symbolId: symbolId,
+				time: exports.time(buffer, offset),
+				lastPrice: exports.price(buffer, offset),
+				precision: exports.precision(buffer, offset),
+				lastSize: exports.size(buffer, offset),
+				lastExchange: buffer[offset + 1],
+				conditions: exports.conditions(buffer, offset),
+				flags: exports.flags(buffer, offset),
+			}
+		case Quote:
+			return {
+				message: 'stream-update-quote',
+				symbol: symbols && symbols[symbolId],
+				symbolId: symbolId,
+				time: exports.time(buffer, offset),
+				bidPrice: exports.price(buffer, offset),
+				bidSize: exports.size(buffer, offset),
+				bidExchange: buffer[offset + 1],
+				askPrice: exports.askPrice(buffer, offset),
+				askSize: exports.askSize(buffer, offset),
+				askExchange: buffer[offset + 2],
+				precision: exports.precision(buffer, offset),
+				conditions: exports.conditions(buffer, offset),
+			}
+	}
+	return null
+}